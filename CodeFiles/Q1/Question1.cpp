@@ -9,6 +9,14 @@ Date: 01/26/2024
 #include <vector>
 #include <opencv2/opencv.hpp>
 #include <boost/filesystem.hpp>
+#include "cliOptions.h"
+#include "featureIndex.h"
+#include "jpegCenterPatch.h"
+#include "parallelScan.h"
+#include "patchMatrix.h"
+#include "pipeline.h"
+#include "resultWriter.h"
+#include "topN.h"
 
 using namespace std;
 using namespace cv;
@@ -23,24 +31,114 @@ Mat computeFeatures(const Mat& image) {
     return featureVector;
 }
 
+// Function to decode the part of an image file computeFeatures needs, empty on
+// failure. JPEGs only have their center patch decoded; anything else, or a
+// JPEG the partial decoder refuses, is decoded in full.
+Mat decodeFeatureImage(const vector<uchar>& bytes) {
+    Mat patch;
+    if (bytes.empty() || decodeJpegCenterPatch(bytes.data(), bytes.size(), 7, patch)) {
+        return patch;
+    }
+    try {
+        return imdecode(bytes, IMREAD_COLOR);
+    } catch (const cv::Exception&) {
+        return Mat();
+    }
+}
+
 // Function to compute sum-of-squared-difference distance between two feature vectors
 double computeDistance(const Mat& ft, const Mat& fi) {
-    Mat diff;
-    absdiff(ft, fi, diff);
-    diff.convertTo(diff, CV_64F);
-    return sum(diff.mul(diff))[0];
+    return patchSquaredDistance(ft.ptr<uchar>(), fi.ptr<uchar>(), ft.total() * ft.channels());
+}
+
+// Feature kind stored in indexes built by this binary
+const string kIndexKind = "center-patch-7x7";
+
+// Values per index row: the 7x7 BGR patch
+const uint32_t kIndexDimension = 7 * 7 * 3;
+
+// Patches scored per SSD kernel call when scanning an index
+const size_t kScanBlockRows = 4096;
+
+// Function to extract the center patch of every database image into an on-disk index;
+// with incremental set the existing index is updated, re-extracting only new or changed images
+int buildIndex(const string& databaseDir, const string& indexPath, ThreadPool& pool, bool incremental) {
+    FeatureIndex index;
+    index.kind = kIndexKind;
+    index.dimension = kIndexDimension;
+    if (incremental && !loadFeatureIndex(indexPath, index.kind, index.dimension, 0, index, true)) {
+        return 1;
+    }
+
+    // Patches are stored as bytes; an index from before version 3 holds them as floats
+    convertFeatureIndexToBytes(index);
+
+    // Diff the directory against the index so only new or changed images are extracted
+    vector<string> imagePaths;
+    for (const auto& entry : fs::directory_iterator(databaseDir)) {
+        imagePaths.push_back(entry.path().string());
+    }
+    IndexUpdate update = planIndexUpdate(index, imagePaths);
+
+    // Workers fill their own rows, and each file is hashed from the bytes it is decoded from
+    const size_t dimension = index.dimension;
+    vector<uchar> rows(update.paths.size() * dimension);
+    vector<char> extracted(update.paths.size(), 0);
+    parallelFor(pool, update.paths.size(), [&](size_t i) {
+        vector<uchar> bytes = readFileBytes(update.paths[i]);
+        update.stamps[i].hash = hashBytes(bytes.data(), bytes.size());
+        Mat image = decodeFeatureImage(bytes);
+        if (image.empty()) {
+            cerr << "Error: Unable to read image " << update.paths[i] << endl;
+            return;
+        }
+
+        Mat fi = computeFeatures(image);
+        copy(fi.ptr<uchar>(), fi.ptr<uchar>() + dimension, rows.begin() + i * dimension);
+        extracted[i] = 1;
+    });
+
+    size_t extractedCount = 0;
+    for (size_t i = 0; i < update.paths.size(); ++i) {
+        applyIndexUpdate(index, update, i, extracted[i] ? rows.data() + i * dimension : nullptr);
+        extractedCount += extracted[i];
+    }
+    compactFeatureIndexIfSparse(index);
+
+    if (!saveFeatureIndex(index, indexPath)) {
+        return 1;
+    }
+    printIndexUpdate(update, extractedCount, index, indexPath);
+    return 0;
 }
 
 int main(int argc, char** argv) {
+    int threads = 0;
+    if (!takeThreadCount(argc, argv, threads)) {
+        return 1;
+    }
+    bool headless = takeFlag(argc, argv, "--headless");
     if (argc < 4) {
-        cerr << "Usage: " << argv[0] << " <target_image_path> <database_dir> <N>" << endl;
+        cerr << "Usage: " << argv[0] << " [--threads N] [--headless] <target_image_path> <database_dir|index_file> <N>" << endl;
+        cerr << "       " << argv[0] << " [--threads N] index <database_dir> <index_file>" << endl;
+        cerr << "       " << argv[0] << " [--threads N] update <database_dir> <index_file>" << endl;
         return 1;
     }
 
+    // Images are spread over the pool, so keep OpenCV's own threads out of the way
+    setNumThreads(1);
+    ThreadPool pool(threads);
+
+    // Build or update the feature index instead of querying
+    if (string(argv[1]) == "index" || string(argv[1]) == "update") {
+        return buildIndex(argv[2], argv[3], pool, string(argv[1]) == "update");
+    }
+
     // Read command-line arguments
     string targetImagePath = argv[1];
     string databaseDir = argv[2];
     int N = stoi(argv[3]);
+    Stopwatch stopwatch;
 
     // Read target image
     Mat targetImage = imread(targetImagePath);
@@ -51,37 +149,85 @@ int main(int argc, char** argv) {
 
     // Compute features for the target image
     Mat ft = computeFeatures(targetImage);
+    double targetMillis = stopwatch.millis();
 
-    // Loop over the directory of images
-    vector<pair<double, string>> matches; // (distance, image_path) pairs
-    for (const auto& entry : fs::directory_iterator(databaseDir)) {
-        string imagePath = entry.path().string();
-        Mat image = imread(imagePath);
-        if (image.empty()) {
-            cerr << "Error: Unable to read image " << imagePath << endl;
-            continue;
+    // Each worker keeps only its N closest matches, identified by position in imagePaths
+    vector<string> imagePaths;
+    vector<TopN<size_t>> partials;
+
+    // Compare against a prebuilt index when one is given instead of a directory
+    if (fs::is_regular_file(databaseDir) && isFeatureIndexFile(databaseDir)) {
+        FeatureIndex index;
+        if (!loadFeatureIndex(databaseDir, kIndexKind, kIndexDimension, 0, index)) {
+            return 1;
         }
 
-        // Compute features for the current image
-        Mat fi = computeFeatures(image);
+        // Every worker copies its block of stored patches into the padded
+        // matrix before scoring it; float rows of older indexes are rounded
+        PatchMatrix patches;
+        patches.reset(index.size(), index.dimension);
+        vector<uint8_t> query = padPatchQuery(patches, ft.ptr<uchar>());
+        size_t blocks = (patches.rows() + kScanBlockRows - 1) / kScanBlockRows;
+        partials = parallelScan(pool, blocks, TopN<size_t>(N), [&](size_t block, TopN<size_t>& best) {
+            thread_local vector<uint32_t> distances;
+            size_t first = block * kScanBlockRows;
+            size_t blockRows = min(kScanBlockRows, patches.rows() - first);
+            if (index.valueBytes == 1) {
+                copyPatchRows(index.byteRow(0), first, blockRows, patches);
+            } else {
+                fillPatchRows(index.row(0), first, blockRows, patches);
+            }
+            distances.resize(blockRows);
+            patchSquaredDistances(patches, first, blockRows, query.data(), distances.data());
+            for (size_t r = 0; r < blockRows; ++r) {
+                best.push(distances[r], first + r);
+            }
+        }, 1);
+        imagePaths.swap(index.paths);
+    } else {
+        // Otherwise scan the directory of images
+        for (const auto& entry : fs::directory_iterator(databaseDir)) {
+            imagePaths.push_back(entry.path().string());
+        }
+        partials = parallelScan(pool, imagePaths.size(), TopN<size_t>(N), [&](size_t i, TopN<size_t>& best) {
+            Mat image = decodeFeatureImage(readFileBytes(imagePaths[i]));
+            if (image.empty()) {
+                cerr << "Error: Unable to read image " << imagePaths[i] << endl;
+                return;
+            }
+
+            // Compute features for the current image
+            Mat fi = computeFeatures(image);
+
+            // Compute distance between target image and current image
+            double distance = computeDistance(ft, fi);
+
+            // Keep the result if it is among the N closest so far
+            best.push(distance, i);
+        });
+    }
 
-        // Compute distance between target image and current image
-        double distance = computeDistance(ft, fi);
+    // Merge the per-thread results, closest first
+    vector<TopN<size_t>::Entry> matches = mergeTopN(partials).sorted();
 
-        // Store the result
-        matches.push_back({distance, imagePath});
+    // Print machine-readable results without touching the GUI or decoding the matches again
+    if (headless) {
+        double totalMillis = stopwatch.millis();
+        NamedValues timings = { { "target", targetMillis }, { "scan", totalMillis - targetMillis }, { "total", totalMillis } };
+        for (size_t i = 0; i < matches.size(); ++i) {
+            writeResultRecord(cout, targetImagePath, i + 1, imagePaths[matches[i].id], matches[i].distance, NamedValues(), timings);
+        }
+        return 0;
     }
 
-    // Sort the list of matches based on distance
-    sort(matches.begin(), matches.end());
-
     // Output the top N matches
     cout << "Top " << N << " matches:" << endl;
-    for (int i = 0; i < min(N, (int)matches.size()); ++i) {
-        cout << matches[i].second << " (Distance: " << matches[i].first << ")" << endl;
+    for (size_t i = 0; i < matches.size(); ++i) {
+        const string& imagePath = imagePaths[matches[i].id];
+        cout << imagePath << " (Distance: " << matches[i].distance << ")" << endl;
         
         // Display the top N closest images
-        Mat closestImage = imread(matches[i].second);
+        Mat closestImage = imread(imagePath);
         if (!closestImage.empty()) {
             imshow("Closest Image " + to_string(i+1), closestImage);
         }
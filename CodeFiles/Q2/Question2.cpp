@@ -9,6 +9,15 @@ Date: 01/26/2024
 #include <vector>
 #include <opencv2/opencv.hpp>
 #include <boost/filesystem.hpp>
+#include "chiSquared.h"
+#include "colorHistograms.h"
+#include "cliOptions.h"
+#include "featureIndex.h"
+#include "imageDecode.h"
+#include "parallelScan.h"
+#include "pipeline.h"
+#include "resultWriter.h"
+#include "topN.h"
 
 using namespace std;
 using namespace cv;
@@ -16,49 +25,15 @@ namespace fs = boost::filesystem;
 
 
 double computeChiSquaredDistance(const Mat& hist1, const Mat& hist2) {
-    // Ensure the histograms have the same dimensions
-    assert(hist1.size() == hist2.size());
-
-    double distance = 0.0;
-    for (int i = 0; i < hist1.rows; ++i) {
-        for (int j = 0; j < hist1.cols; ++j) {
-            double diff = hist1.at<float>(i, j) - hist2.at<float>(i, j);
-            double sum = hist1.at<float>(i, j) + hist2.at<float>(i, j);
-            if (sum != 0) {
-                distance += (diff * diff) / sum;
-            }
-        }
-    }
-
-    return distance;
+    return chiSquaredDistance(hist1, hist2);
 }
 
 // Function to compute RG chromaticity histogram for a given image
 Mat computeRGChromaticityHistogram(const Mat& image, int numBins) {
-    Mat hist;
-
-    // Convert image to float
-    Mat floatImage;
-    image.convertTo(floatImage, CV_32F);
-
-    // Compute RG chromaticity histogram
-    Mat rgHist;
-    int histSize[] = { numBins, numBins };
-    float rRanges[] = { 0, 256 };
-    float gRanges[] = { 0, 256 };
-    const float* ranges[] = { rRanges, gRanges };
-    int channels[] = { 0, 1 };
-    try {
-        calcHist(&floatImage, 1, channels, Mat(), rgHist, 2, histSize, ranges, true, false);
-    } catch (const cv::Exception& e) {
-        cerr << "Error computing histogram: " << e.what() << endl;
-        return Mat(); // Return empty histogram on error
-    }
-
-    // Normalize histogram
-    normalize(rgHist, hist, 0, 1, NORM_MINMAX, -1, Mat());
-
-    return hist;
+    // One pass over the 8-bit pixels, no float copy of the image
+    ColorHistogramSpec spec;
+    spec.rgBins = numBins;
+    return computeColorHistograms(image, spec).rg;
 }
 
 // Function to compute correlation distance between two histograms
@@ -66,22 +41,129 @@ double computeCorrelationDistance(const Mat& hist1, const Mat& hist2) {
     return 1.0 - compareHist(hist1, hist2, HISTCMP_CORREL);
 }
 
+// Feature kind stored in indexes built by this binary
+const string kIndexKind = "rg-chromaticity-16";
+
+// Values per index row: the 16x16 RG histogram
+const uint32_t kIndexDimension = 16 * 16;
+
+// Function to extract the histogram of every database image into an on-disk index;
+// with incremental set the existing index is updated, re-extracting only new or changed images
+int buildIndex(const string& databaseDir, const string& indexPath, const PipelineOptions& stages, const DecodeOptions& decode, bool incremental) {
+    FeatureIndex index;
+    index.kind = decodeKind(kIndexKind, decode);
+    index.dimension = kIndexDimension;
+    if (incremental && !loadFeatureIndex(indexPath, index.kind, index.dimension, index.valueBytes, index, true)) {
+        return 1;
+    }
 
+    // Diff the directory against the index so only new or changed images are extracted
+    vector<string> imagePaths;
+    for (const auto& entry : fs::directory_iterator(databaseDir)) {
+        imagePaths.push_back(entry.path().string());
+    }
+    IndexUpdate update = planIndexUpdate(index, imagePaths);
 
+    // Reading, decoding and extraction overlap in a pipeline; extractors fill
+    // their own rows, and each file is hashed as it is read
+    const size_t dimension = index.dimension;
+    vector<float> rows(update.paths.size() * dimension);
+    vector<char> extracted(update.paths.size(), 0);
+    runPipeline(update.paths.size(), stages, [&](size_t i) {
+                    vector<uchar> bytes = readFileBytes(update.paths[i]);
+                    update.stamps[i].hash = hashBytes(bytes.data(), bytes.size());
+                    return bytes;
+                },
+                [&](vector<uchar>& bytes) { return decodeImage(bytes, decode); },
+                [&](int, size_t i, Mat& image) {
+        if (image.empty()) {
+            cerr << "Error: Unable to read image " << update.paths[i] << endl;
+            return;
+        }
+
+        Mat imageHist = computeRGChromaticityHistogram(image, 16);
+        if (imageHist.empty()) {
+            cerr << "Error: Unable to compute histogram for image " << update.paths[i] << endl;
+            return;
+        }
+        copy(imageHist.ptr<float>(), imageHist.ptr<float>() + dimension, rows.begin() + i * dimension);
+        extracted[i] = 1;
+    });
+
+    size_t extractedCount = 0;
+    for (size_t i = 0; i < update.paths.size(); ++i) {
+        applyIndexUpdate(index, update, i, extracted[i] ? rows.data() + i * dimension : nullptr);
+        extractedCount += extracted[i];
+    }
+    compactFeatureIndexIfSparse(index);
+
+    if (!saveFeatureIndex(index, indexPath)) {
+        return 1;
+    }
+    printIndexUpdate(update, extractedCount, index, indexPath);
+    return 0;
+}
+
+
+// Function to report how far reduced decoding moves the histograms of a database directory
+int reportDecodeDrift(const string& databaseDir, const DecodeOptions& decode) {
+    if (decode.reduction == 1 && decode.maxSide <= 0) {
+        cerr << "Error: drift needs --reduce or --max-side." << endl;
+        return 1;
+    }
+    vector<string> imagePaths;
+    for (const auto& entry : fs::directory_iterator(databaseDir)) {
+        imagePaths.push_back(entry.path().string());
+    }
+
+    DecodeDrift drift = measureDecodeDrift(imagePaths, decode, [](const Mat& image) {
+        return computeRGChromaticityHistogram(image, 16);
+    });
+    printDecodeDrift(kIndexKind, drift);
+    return 0;
+}
 
 int main(int argc, char** argv) {
+    int threads = 0;
+    if (!takeThreadCount(argc, argv, threads)) {
+        return 1;
+    }
+    bool headless = takeFlag(argc, argv, "--headless");
+    DecodeOptions decode;
+    if (!takeDecodeOptions(argc, argv, decode)) {
+        return 1;
+    }
+
+    // Compare reduced decoding against full decoding instead of querying
+    if (argc == 3 && string(argv[1]) == "drift") {
+        return reportDecodeDrift(argv[2], decode);
+    }
     if (argc < 4) {
-        cerr << "Usage: " << argv[0] << " <target_image_path> <database_dir> <N>" << endl;
+        cerr << "Usage: " << argv[0] << " [--threads N] [--reduce 2|4|8 | --max-side N] [--headless] <target_image_path> <database_dir|index_file> <N>" << endl;
+        cerr << "       " << argv[0] << " [--threads N] [--reduce 2|4|8 | --max-side N] index <database_dir> <index_file>" << endl;
+        cerr << "       " << argv[0] << " [--threads N] [--reduce 2|4|8 | --max-side N] update <database_dir> <index_file>" << endl;
+        cerr << "       " << argv[0] << " (--reduce 2|4|8 | --max-side N) drift <database_dir>" << endl;
         return 1;
     }
 
+    // Images are spread over the pool and pipeline, so keep OpenCV's own threads out of the way
+    setNumThreads(1);
+    ThreadPool pool(threads);
+    PipelineOptions stages = pipelineOptionsFor(threads);
+
+    // Build or update the feature index instead of querying
+    if (string(argv[1]) == "index" || string(argv[1]) == "update") {
+        return buildIndex(argv[2], argv[3], stages, decode, string(argv[1]) == "update");
+    }
+
     // Read command-line arguments
     string targetImagePath = argv[1];
     string databaseDir = argv[2];
     int N = stoi(argv[3]);
+    Stopwatch stopwatch;
 
-    // Read target image
-    Mat targetImage = imread(targetImagePath);
+    // Decode the target the same way as the database so both histograms see the same scale
+    Mat targetImage = decodeImage(readFileBytes(targetImagePath), decode);
     if (targetImage.empty()) {
         cerr << "Error: Unable to read target image." << endl;
         return 1;
@@ -93,41 +175,75 @@ int main(int argc, char** argv) {
         cerr << "Error: Unable to compute histogram for the target image." << endl;
         return 1;
     }
+    double targetMillis = stopwatch.millis();
 
-    // Loop over the directory of images
-    vector<pair<double, string>> matches; // (distance, image_path) pairs
-    for (const auto& entry : fs::directory_iterator(databaseDir)) {
-        string imagePath = entry.path().string();
-        Mat image = imread(imagePath);
-        if (image.empty()) {
-            cerr << "Error: Unable to read image " << imagePath << endl;
-            continue;
-        }
+    // Each worker keeps only its N closest matches, identified by position in imagePaths
+    vector<string> imagePaths;
+    vector<TopN<size_t>> partials;
 
-        // Compute histogram for the current image
-        Mat imageHist = computeRGChromaticityHistogram(image, 16);
-        if (imageHist.empty()) {
-            cerr << "Error: Unable to compute histogram for image " << imagePath << endl;
-            continue;
+    // Compare against a prebuilt index when one is given instead of a directory
+    if (fs::is_regular_file(databaseDir) && isFeatureIndexFile(databaseDir)) {
+        FeatureIndex index;
+        if (!loadFeatureIndex(databaseDir, decodeKind(kIndexKind, decode), kIndexDimension, sizeof(float), index)) {
+            return 1;
+        }
+        partials = parallelScan(pool, index.size(), TopN<size_t>(N), [&](size_t i, TopN<size_t>& best) {
+            Mat imageHist(16, 16, CV_32F, const_cast<float*>(index.row(i)));
+            double distance = computeChiSquaredDistance(targetHist, imageHist);
+            best.push(distance, i);
+        });
+        imagePaths.swap(index.paths);
+    } else {
+        // Otherwise stream the directory of images through the read/decode/extract pipeline
+        for (const auto& entry : fs::directory_iterator(databaseDir)) {
+            imagePaths.push_back(entry.path().string());
         }
+        partials.assign(stages.extractors, TopN<size_t>(N));
+        runPipeline(imagePaths.size(), stages, [&](size_t i) { return readFileBytes(imagePaths[i]); },
+                    [&](vector<uchar>& bytes) { return decodeImage(bytes, decode); },
+                    [&](int worker, size_t i, Mat& image) {
+            TopN<size_t>& best = partials[worker];
+            if (image.empty()) {
+                cerr << "Error: Unable to read image " << imagePaths[i] << endl;
+                return;
+            }
+
+            // Compute histogram for the current image
+            Mat imageHist = computeRGChromaticityHistogram(image, 16);
+            if (imageHist.empty()) {
+                cerr << "Error: Unable to compute histogram for image " << imagePaths[i] << endl;
+                return;
+            }
 
-        // Compute histogram intersection distance between target and current image
-        double distance = computeChiSquaredDistance(targetHist, imageHist);
+            // Compute histogram intersection distance between target and current image
+            double distance = computeChiSquaredDistance(targetHist, imageHist);
 
-        // Store the result
-        matches.push_back({distance, imagePath});
+            // Keep the result if it is among the N closest so far
+            best.push(distance, i);
+        });
     }
 
-    // Sort the list of matches based on distance
-    sort(matches.begin(), matches.end());
+    // Merge the per-thread results, closest first
+    vector<TopN<size_t>::Entry> matches = mergeTopN(partials).sorted();
+
+    // Print machine-readable results without touching the GUI or decoding the matches again
+    if (headless) {
+        double totalMillis = stopwatch.millis();
+        NamedValues timings = { { "target", targetMillis }, { "scan", totalMillis - targetMillis }, { "total", totalMillis } };
+        for (size_t i = 0; i < matches.size(); ++i) {
+            writeResultRecord(cout, targetImagePath, i + 1, imagePaths[matches[i].id], matches[i].distance, NamedValues(), timings);
+        }
+        return 0;
+    }
 
     // Output the top N matches
     cout << "Top " << N << " matches:" << endl;
-    for (int i = 0; i < min(N, (int)matches.size()); ++i) {
-        cout << matches[i].second << " (Distance: " << matches[i].first << ")" << endl;
+    for (size_t i = 0; i < matches.size(); ++i) {
+        const string& imagePath = imagePaths[matches[i].id];
+        cout << imagePath << " (Distance: " << matches[i].distance << ")" << endl;
         
         // Display the top N closest images
-        Mat closestImage = imread(matches[i].second);
+        Mat closestImage = imread(imagePath);
         if (!closestImage.empty()) {
             imshow("Closest Image " + to_string(i+1), closestImage);
         }
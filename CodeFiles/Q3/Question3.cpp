@@ -5,133 +5,283 @@ Date: 01/26/2024
 
 */
 
+#include <array>
 #include <iostream>
 #include <vector>
 #include <string>
 #include <boost/filesystem.hpp>
 #include <opencv2/opencv.hpp>
+#include "chiSquared.h"
+#include "colorHistograms.h"
+#include "cliOptions.h"
+#include "featureIndex.h"
+#include "imageDecode.h"
+#include "parallelScan.h"
+#include "pipeline.h"
+#include "resultWriter.h"
+#include "topN.h"
 
 using namespace std;
 using namespace cv;
 namespace fs = boost::filesystem;
 
-// Function to compute RGB histogram for a given image
-Mat computeRGChromaticityHistogram(const Mat& image, int numBins) {
-    Mat hist;
-
-    // Convert image to float
-    Mat floatImage;
-    image.convertTo(floatImage, CV_32F);
-
-    // Compute RG chromaticity histogram
-    Mat rgHist;
-    int histSize[] = { numBins, numBins };
-    float rRanges[] = { 0, 256 };
-    float gRanges[] = { 0, 256 };
-    const float* ranges[] = { rRanges, gRanges };
-    int channels[] = { 0, 1 };
-    try {
-        calcHist(&floatImage, 1, channels, Mat(), rgHist, 2, histSize, ranges, true, false);
-    } catch (const cv::Exception& e) {
-        cerr << "Error computing histogram: " << e.what() << endl;
-        return Mat(); // Return empty histogram on error
-    }
-
-    // Normalize histogram
-    normalize(rgHist, hist, 0, 1, NORM_MINMAX, -1, Mat());
-
-    return hist;
+// Function to compute the RG chromaticity histograms of the top and bottom halves in one pass
+bool computeTopBottomHistograms(const Mat& image, int numBins, Mat& hist_top, Mat& hist_bottom) {
+    ColorHistogramSpec spec;
+    spec.halfBins = numBins;
+    ColorHistograms hists = computeColorHistograms(image, spec);
+    hist_top = hists.top;
+    hist_bottom = hists.bottom;
+    return !hist_top.empty() && !hist_bottom.empty();
 }
 
 
 // Function to compute histogram intersection distance between two histograms
 double computeChiSquareDistance(const Mat& hist1, const Mat& hist2) {
-    // Ensure the histograms have the same dimensions
-    assert(hist1.size() == hist2.size());
-
-    double distance = 0.0;
-    for (int i = 0; i < hist1.rows; ++i) {
-        for (int j = 0; j < hist1.cols; ++j) {
-            double numerator = pow(hist1.at<float>(i, j) - hist2.at<float>(i, j), 2);
-            double denominator = hist1.at<float>(i, j) + hist2.at<float>(i, j);
-            if (denominator != 0) {
-                distance += numerator / denominator;
-            }
-        }
-    }
-
-    return distance;
+    return chiSquaredDistance(hist1, hist2);
 }
 
-// Function to compute multi-histogram distance
-double computeMultiHistogramDistance(const Mat& hist1_top, const Mat& hist2_top, const Mat& hist1_bottom, const Mat& hist2_bottom) {
+// Function to compute multi-histogram distance, keeping the top and bottom distances in components
+double computeMultiHistogramDistance(const Mat& hist1_top, const Mat& hist2_top, const Mat& hist1_bottom, const Mat& hist2_bottom, array<double, 2>& components) {
     // Compute histogram intersection distances for top and bottom halves
     double distance_top = computeChiSquareDistance(hist1_top, hist2_top);
     double distance_bottom = computeChiSquareDistance(hist1_bottom, hist2_bottom);
-    
+    components = { distance_top, distance_bottom };
+
     // Weighted averaging
     double weight_top = 0.5; // Equal weight for top and bottom halves
     double weight_bottom = 0.5;
     return weight_top * distance_top + weight_bottom * distance_bottom;
 }
 
+// Feature kind stored in indexes built by this binary
+const string kIndexKind = "rg-top-bottom-8";
+
+// Values per index row: the two 8x8 RG histograms
+const uint32_t kIndexDimension = 8 * 8 * 2;
+
+// Function to extract the top and bottom histograms of every database image into an on-disk index;
+// with incremental set the existing index is updated, re-extracting only new or changed images
+int buildIndex(const string& databaseDirPath, const string& indexPath, const PipelineOptions& stages, const DecodeOptions& decode, bool incremental) {
+    FeatureIndex index;
+    index.kind = decodeKind(kIndexKind, decode);
+    index.dimension = kIndexDimension;
+    if (incremental && !loadFeatureIndex(indexPath, index.kind, index.dimension, index.valueBytes, index, true)) {
+        return 1;
+    }
+
+    // Diff the directory against the index so only new or changed images are extracted
+    vector<string> imagePaths;
+    for (const auto& entry : fs::directory_iterator(databaseDirPath)) {
+        imagePaths.push_back(entry.path().string());
+    }
+    IndexUpdate update = planIndexUpdate(index, imagePaths);
+
+    // Reading, decoding and extraction overlap in a pipeline; extractors fill
+    // their own rows, and each file is hashed as it is read
+    const size_t dimension = index.dimension;
+    vector<float> rows(update.paths.size() * dimension);
+    vector<char> extracted(update.paths.size(), 0);
+    runPipeline(update.paths.size(), stages, [&](size_t i) {
+                    vector<uchar> bytes = readFileBytes(update.paths[i]);
+                    update.stamps[i].hash = hashBytes(bytes.data(), bytes.size());
+                    return bytes;
+                },
+                [&](vector<uchar>& bytes) { return decodeImage(bytes, decode); },
+                [&](int, size_t i, Mat& image) {
+        if (image.empty()) {
+            cerr << "Error: Unable to read image " << update.paths[i] << endl;
+            return;
+        }
+
+        // Compute RGB histograms for current image
+        Mat hist_top, hist_bottom;
+        if (!computeTopBottomHistograms(image, 8, hist_top, hist_bottom)) {
+            cerr << "Error: Unable to compute histograms for image " << update.paths[i] << endl;
+            return;
+        }
+
+        // Store the top half followed by the bottom half
+        float* row = rows.data() + i * dimension;
+        copy(hist_top.ptr<float>(), hist_top.ptr<float>() + hist_top.total(), row);
+        copy(hist_bottom.ptr<float>(), hist_bottom.ptr<float>() + hist_bottom.total(), row + hist_top.total());
+        extracted[i] = 1;
+    });
+
+    size_t extractedCount = 0;
+    for (size_t i = 0; i < update.paths.size(); ++i) {
+        applyIndexUpdate(index, update, i, extracted[i] ? rows.data() + i * dimension : nullptr);
+        extractedCount += extracted[i];
+    }
+    compactFeatureIndexIfSparse(index);
+
+    if (!saveFeatureIndex(index, indexPath)) {
+        return 1;
+    }
+    printIndexUpdate(update, extractedCount, index, indexPath);
+    return 0;
+}
+
+// Function to report how far reduced decoding moves the histograms of a database directory
+int reportDecodeDrift(const string& databaseDirPath, const DecodeOptions& decode) {
+    if (decode.reduction == 1 && decode.maxSide <= 0) {
+        cerr << "Error: drift needs --reduce or --max-side." << endl;
+        return 1;
+    }
+    vector<string> imagePaths;
+    for (const auto& entry : fs::directory_iterator(databaseDirPath)) {
+        imagePaths.push_back(entry.path().string());
+    }
+
+    DecodeDrift topDrift = measureDecodeDrift(imagePaths, decode, [](const Mat& image) {
+        Mat hist_top, hist_bottom;
+        computeTopBottomHistograms(image, 8, hist_top, hist_bottom);
+        return hist_top;
+    });
+    DecodeDrift bottomDrift = measureDecodeDrift(imagePaths, decode, [](const Mat& image) {
+        Mat hist_top, hist_bottom;
+        computeTopBottomHistograms(image, 8, hist_top, hist_bottom);
+        return hist_bottom;
+    });
+    printDecodeDrift("top half", topDrift);
+    printDecodeDrift("bottom half", bottomDrift);
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
+    int threads = 0;
+    if (!takeThreadCount(argc, argv, threads)) {
+        return 1;
+    }
+    bool headless = takeFlag(argc, argv, "--headless");
+    DecodeOptions decode;
+    if (!takeDecodeOptions(argc, argv, decode)) {
+        return 1;
+    }
+
+    // Compare reduced decoding against full decoding instead of querying
+    if (argc == 3 && string(argv[1]) == "drift") {
+        return reportDecodeDrift(argv[2], decode);
+    }
     if (argc < 4) {
-        cerr << "Usage: " << argv[0] << " <target_image_path> <database_dir_path> <N>" << endl;
+        cerr << "Usage: " << argv[0] << " [--threads N] [--reduce 2|4|8 | --max-side N] <target_image_path> <database_dir_path|index_file> <N>" << endl;
+        cerr << "       " << argv[0] << " [--threads N] [--reduce 2|4|8 | --max-side N] index <database_dir_path> <index_file>" << endl;
+        cerr << "       " << argv[0] << " [--threads N] [--reduce 2|4|8 | --max-side N] update <database_dir_path> <index_file>" << endl;
+        cerr << "       " << argv[0] << " (--reduce 2|4|8 | --max-side N) drift <database_dir_path>" << endl;
         return 1;
     }
 
-    // Read target image
-    Mat targetImage = imread(argv[1]);
+    // Images are spread over the pool and pipeline, so keep OpenCV's own threads out of the way
+    setNumThreads(1);
+    ThreadPool pool(threads);
+    PipelineOptions stages = pipelineOptionsFor(threads);
+
+    // Build or update the feature index instead of querying
+    if (string(argv[1]) == "index" || string(argv[1]) == "update") {
+        return buildIndex(argv[2], argv[3], stages, decode, string(argv[1]) == "update");
+    }
+
+    Stopwatch stopwatch;
+
+    // Decode the target the same way as the database so both histograms see the same scale
+    Mat targetImage = decodeImage(readFileBytes(argv[1]), decode);
     if (targetImage.empty()) {
         cerr << "Error: Unable to read target image." << endl;
         return 1;
     }
 
     // Compute RGB histograms for target image
-    Mat hist_target_top = computeRGChromaticityHistogram(targetImage(Rect(0, 0, targetImage.cols, targetImage.rows / 2)), 8);
-    Mat hist_target_bottom = computeRGChromaticityHistogram(targetImage(Rect(0, targetImage.rows / 2, targetImage.cols, targetImage.rows / 2)), 8);
+    Mat hist_target_top, hist_target_bottom;
+    if (!computeTopBottomHistograms(targetImage, 8, hist_target_top, hist_target_bottom)) {
+        cerr << "Error: Unable to compute histograms for the target image." << endl;
+        return 1;
+    }
+
+    double targetMillis = stopwatch.millis();
 
     // Read database directory
     string databaseDirPath = argv[2];
     int N = atoi(argv[3]);
 
-    // Vector to store distances and file paths
-    vector<pair<double, string>> distances;
+    // Each worker keeps only its N closest images, identified by position in imagePaths;
+    // each kept match carries its per-histogram distances for the headless output
+    vector<string> imagePaths;
+    vector<TopN<ScoredRow<2>>> partials;
 
-    // Iterate over images in the database directory
-    for (const auto& entry : fs::directory_iterator(databaseDirPath)) {
-        // Read image
-        Mat image = imread(entry.path().string());
-        if (image.empty()) {
-            cerr << "Error: Unable to read image " << entry.path().string() << endl;
-            continue;
+    // Compare against a prebuilt index when one is given instead of a directory
+    if (fs::is_regular_file(databaseDirPath) && isFeatureIndexFile(databaseDirPath)) {
+        FeatureIndex index;
+        if (!loadFeatureIndex(databaseDirPath, decodeKind(kIndexKind, decode), kIndexDimension, sizeof(float), index)) {
+            return 1;
         }
+        partials = parallelScan(pool, index.size(), TopN<ScoredRow<2>>(N), [&](size_t i, TopN<ScoredRow<2>>& best) {
+            float* row = const_cast<float*>(index.row(i));
+            Mat hist_top(8, 8, CV_32F, row);
+            Mat hist_bottom(8, 8, CV_32F, row + 8 * 8);
+            ScoredRow<2> match;
+            match.row = i;
+            double distance = computeMultiHistogramDistance(hist_target_top, hist_top, hist_target_bottom, hist_bottom, match.components);
+            best.push(distance, match);
+        });
+        imagePaths.swap(index.paths);
+    } else {
+        // Otherwise stream the database directory through the read/decode/extract pipeline
+        for (const auto& entry : fs::directory_iterator(databaseDirPath)) {
+            imagePaths.push_back(entry.path().string());
+        }
+        partials.assign(stages.extractors, TopN<ScoredRow<2>>(N));
+        runPipeline(imagePaths.size(), stages, [&](size_t i) { return readFileBytes(imagePaths[i]); },
+                    [&](vector<uchar>& bytes) { return decodeImage(bytes, decode); },
+                    [&](int worker, size_t i, Mat& image) {
+            TopN<ScoredRow<2>>& best = partials[worker];
+            if (image.empty()) {
+                cerr << "Error: Unable to read image " << imagePaths[i] << endl;
+                return;
+            }
 
-        // Compute RGB histograms for current image
-        Mat hist_top = computeRGChromaticityHistogram(image(Rect(0, 0, image.cols, image.rows / 2)), 8);
-        Mat hist_bottom = computeRGChromaticityHistogram(image(Rect(0, image.rows / 2, image.cols, image.rows / 2)), 8);
+            // Compute RGB histograms for current image
+            Mat hist_top, hist_bottom;
+            if (!computeTopBottomHistograms(image, 8, hist_top, hist_bottom)) {
+                cerr << "Error: Unable to compute histograms for image " << imagePaths[i] << endl;
+                return;
+            }
 
-        // Compute multi-histogram distance
-        double distance = computeMultiHistogramDistance(hist_target_top, hist_top, hist_target_bottom, hist_bottom);
+            // Compute multi-histogram distance
+            ScoredRow<2> match;
+            match.row = i;
+            double distance = computeMultiHistogramDistance(hist_target_top, hist_top, hist_target_bottom, hist_bottom, match.components);
 
-        // Store distance and file path
-        distances.push_back(make_pair(distance, entry.path().string()));
+            // Keep the distance if it is among the N closest so far
+            best.push(distance, match);
+        });
     }
 
-    // Sort images based on distances
-    sort(distances.begin(), distances.end());
+    // Merge the per-thread results, closest first
+    vector<TopN<ScoredRow<2>>::Entry> distances = mergeTopN(partials).sorted();
+
+    // Print machine-readable results without touching the GUI or decoding the matches again
+    if (headless) {
+        double totalMillis = stopwatch.millis();
+        NamedValues timings = { { "target", targetMillis }, { "scan", totalMillis - targetMillis }, { "total", totalMillis } };
+        for (size_t i = 0; i < distances.size(); ++i) {
+            const array<double, 2>& parts = distances[i].id.components;
+            NamedValues componentDistances = { { "top", parts[0] }, { "bottom", parts[1] } };
+            writeResultRecord(cout, argv[1], i + 1, imagePaths[distances[i].id.row], distances[i].distance, componentDistances, timings);
+        }
+        return 0;
+    }
 
 
     // Display the top N images
-for (int i = 0; i < min(N, (int)distances.size()); ++i) {
+for (size_t i = 0; i < distances.size(); ++i) {
     // Load and display the image
-    Mat image = imread(distances[i].second);
+    const string& imagePath = imagePaths[distances[i].id.row];
+    Mat image = imread(imagePath);
     if (!image.empty()) {
         imshow("Image " + to_string(i + 1), image);
-        cout << "Distance: " << distances[i].first << ", Image: " << distances[i].second << endl;
+        cout << "Distance: " << distances[i].distance << ", Image: " << imagePath << endl;
     } else {
-        cerr << "Error: Unable to read image " << distances[i].second << endl;
+        cerr << "Error: Unable to read image " << imagePath << endl;
     }
 }
 waitKey(0); // Wait for a key press to exit
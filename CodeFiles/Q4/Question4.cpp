@@ -5,11 +5,22 @@ Date: 01/26/2024
 
 */
 
+#include <array>
 #include <iostream>
 #include <vector>
 #include <string>
 #include <boost/filesystem.hpp>
 #include <opencv2/opencv.hpp>
+#include "chiSquared.h"
+#include "colorHistograms.h"
+#include "cliOptions.h"
+#include "featureIndex.h"
+#include "imageDecode.h"
+#include "parallelScan.h"
+#include "pipeline.h"
+#include "resultWriter.h"
+#include "textureHistogram.h"
+#include "topN.h"
 
 using namespace std;
 using namespace cv;
@@ -17,103 +28,168 @@ namespace fs = boost::filesystem;
 
 // Function to compute color histogram for a given image
 Mat computeColorHistogram(const Mat& image, int numBins) {
-    Mat hist;
-
-    // Convert image to float
-    Mat floatImage;
-    image.convertTo(floatImage, CV_32F);
-
-    // Compute color histogram
-    vector<Mat> bgr_planes;
-    split(floatImage, bgr_planes);
-    int histSize[] = { numBins, numBins, numBins };
-    float range[] = { 0, 256 };
-    const float* ranges[] = { range, range, range };
-    int channels[] = { 0, 1, 2 };
-    try {
-        calcHist(&floatImage, 1, channels, Mat(), hist, 3, histSize, ranges, true, false);
-    } catch (const cv::Exception& e) {
-        cerr << "Error computing color histogram: " << e.what() << endl;
-        return Mat(); // Return empty histogram on error
-    }
-
-    // Normalize histogram
-    normalize(hist, hist, 0, 1, NORM_MINMAX, -1, Mat());
-
-    return hist;
+    // One pass over the 8-bit pixels, no float copy or channel split
+    ColorHistogramSpec spec;
+    spec.colorBins = numBins;
+    return computeColorHistograms(image, spec).color;
 }
 
-// Function to compute texture histogram for a given image (histogram of gradient orientations and magnitudes)
-Mat computeTextureHistogram(const Mat& image, int numBins) {
-    Mat gray;
-    cvtColor(image, gray, COLOR_BGR2GRAY);
-
-    // Compute gradients
-    Mat gx, gy;
-    Sobel(gray, gx, CV_32F, 1, 0);
-    Sobel(gray, gy, CV_32F, 0, 1);
-
-    // Calculate magnitude and angle
-    Mat mag, angle;
-    cartToPolar(gx, gy, mag, angle, true);
-
-    // Compute texture histogram (histogram of gradient orientations)
-    Mat hist;
-    int histSize[] = { numBins };
-    float range[] = { 0, 360 };
-    const float* ranges[] = { range };
-    try {
-        calcHist(&angle, 1, 0, Mat(), hist, 1, histSize, ranges, true, false);
-    } catch (const cv::Exception& e) {
-        cerr << "Error computing texture histogram: " << e.what() << endl;
-        return Mat(); // Return empty histogram on error
-    }
-
-    // Normalize histogram
-    normalize(hist, hist, 0, 1, NORM_MINMAX, -1, Mat());
-
-    return hist;
+// Function to compute texture histogram for a given image (histogram of gradient orientations, optionally weighted by magnitude)
+Mat computeTextureHistogram(const Mat& image, int numBins, bool magnitudeWeighted) {
+    // Gradients and orientations are streamed row by row instead of through full-frame gray/gx/gy/mag/angle images
+    return computeOrientationHistogram(image, numBins, magnitudeWeighted);
 }
 
 // Function to compute Chi-Square distance between two histograms
 double computeChiSquareDistance(const Mat& hist1, const Mat& hist2) {
-    // Ensure the histograms have the same dimensions
-    assert(hist1.size() == hist2.size());
-
-    double distance = 0.0;
-    for (int i = 0; i < hist1.rows; ++i) {
-        for (int j = 0; j < hist1.cols; ++j) {
-            double numerator = pow(hist1.at<float>(i, j) - hist2.at<float>(i, j), 2);
-            double denominator = hist1.at<float>(i, j) + hist2.at<float>(i, j);
-            if (denominator != 0) {
-                distance += numerator / denominator;
-            }
-        }
-    }
-
-    return distance;
+    return chiSquaredDistance(hist1, hist2);
 }
 
-// Function to compute multi-histogram distance
-double computeMultiHistogramDistance(const Mat& hist1_color, const Mat& hist2_color, const Mat& hist1_texture, const Mat& hist2_texture) {
+// Function to compute multi-histogram distance, keeping the color and texture distances in components
+double computeMultiHistogramDistance(const Mat& hist1_color, const Mat& hist2_color, const Mat& hist1_texture, const Mat& hist2_texture, array<double, 2>& components) {
     // Compute Chi-Square distances for color and texture histograms
     double distance_color = computeChiSquareDistance(hist1_color, hist2_color);
     double distance_texture = computeChiSquareDistance(hist1_texture, hist2_texture);
-    
+    components = { distance_color, distance_texture };
+
     // Equal weighting for color and texture distances
     double weight_color = 0.5;
     double weight_texture = 0.5;
     return weight_color * distance_color + weight_texture * distance_texture;
 }
 
+// Function to name the feature kind stored in indexes built by this binary
+string indexKind(bool magnitudeWeighted) {
+    return magnitudeWeighted ? "color-texture-8-magnitude" : "color-texture-8";
+}
+
+// Values per index row: the 8x8x8 color histogram and 8 orientation bins
+const uint32_t kIndexDimension = 8 * 8 * 8 + 8;
+
+// Function to extract the color and texture histograms of every database image into an on-disk index;
+// with incremental set the existing index is updated, re-extracting only new or changed images
+int buildIndex(const string& databaseDirPath, const string& indexPath, const PipelineOptions& stages, const DecodeOptions& decode, bool magnitudeWeighted, bool incremental) {
+    FeatureIndex index;
+    index.kind = decodeKind(indexKind(magnitudeWeighted), decode);
+    index.dimension = kIndexDimension;
+    if (incremental && !loadFeatureIndex(indexPath, index.kind, index.dimension, index.valueBytes, index, true)) {
+        return 1;
+    }
+
+    // Diff the directory against the index so only new or changed images are extracted
+    vector<string> imagePaths;
+    for (const auto& entry : fs::directory_iterator(databaseDirPath)) {
+        imagePaths.push_back(entry.path().string());
+    }
+    IndexUpdate update = planIndexUpdate(index, imagePaths);
+
+    // Reading, decoding and extraction overlap in a pipeline; extractors fill
+    // their own rows, and each file is hashed as it is read
+    const size_t dimension = index.dimension;
+    vector<float> rows(update.paths.size() * dimension);
+    vector<char> extracted(update.paths.size(), 0);
+    runPipeline(update.paths.size(), stages, [&](size_t i) {
+                    vector<uchar> bytes = readFileBytes(update.paths[i]);
+                    update.stamps[i].hash = hashBytes(bytes.data(), bytes.size());
+                    return bytes;
+                },
+                [&](vector<uchar>& bytes) { return decodeImage(bytes, decode); },
+                [&](int, size_t i, Mat& image) {
+        if (image.empty()) {
+            cerr << "Error: Unable to read image " << update.paths[i] << endl;
+            return;
+        }
+
+        // Compute color and texture histograms for current image
+        Mat hist_color = computeColorHistogram(image, 8);
+        Mat hist_texture = computeTextureHistogram(image, 8, magnitudeWeighted);
+        if (hist_color.empty() || hist_texture.empty()) {
+            cerr << "Error: Unable to compute histograms for image " << update.paths[i] << endl;
+            return;
+        }
+
+        // Store the color histogram followed by the texture histogram
+        float* row = rows.data() + i * dimension;
+        copy(hist_color.ptr<float>(), hist_color.ptr<float>() + hist_color.total(), row);
+        copy(hist_texture.ptr<float>(), hist_texture.ptr<float>() + hist_texture.total(), row + hist_color.total());
+        extracted[i] = 1;
+    });
+
+    size_t extractedCount = 0;
+    for (size_t i = 0; i < update.paths.size(); ++i) {
+        applyIndexUpdate(index, update, i, extracted[i] ? rows.data() + i * dimension : nullptr);
+        extractedCount += extracted[i];
+    }
+    compactFeatureIndexIfSparse(index);
+
+    if (!saveFeatureIndex(index, indexPath)) {
+        return 1;
+    }
+    printIndexUpdate(update, extractedCount, index, indexPath);
+    return 0;
+}
+
+// Function to report how far reduced decoding moves the histograms of a database directory
+int reportDecodeDrift(const string& databaseDirPath, const DecodeOptions& decode, bool magnitudeWeighted) {
+    if (decode.reduction == 1 && decode.maxSide <= 0) {
+        cerr << "Error: drift needs --reduce or --max-side." << endl;
+        return 1;
+    }
+    vector<string> imagePaths;
+    for (const auto& entry : fs::directory_iterator(databaseDirPath)) {
+        imagePaths.push_back(entry.path().string());
+    }
+
+    // Gradients shrink with the image, so texture is reported separately from color
+    DecodeDrift colorDrift = measureDecodeDrift(imagePaths, decode, [](const Mat& image) {
+        return computeColorHistogram(image, 8);
+    });
+    DecodeDrift textureDrift = measureDecodeDrift(imagePaths, decode, [&](const Mat& image) {
+        return computeTextureHistogram(image, 8, magnitudeWeighted);
+    });
+    printDecodeDrift("color", colorDrift);
+    printDecodeDrift("texture", textureDrift);
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
+    int threads = 0;
+    if (!takeThreadCount(argc, argv, threads)) {
+        return 1;
+    }
+    bool headless = takeFlag(argc, argv, "--headless");
+    bool magnitudeWeighted = takeFlag(argc, argv, "--magnitude-weighted");
+    DecodeOptions decode;
+    if (!takeDecodeOptions(argc, argv, decode)) {
+        return 1;
+    }
+
+    // Compare reduced decoding against full decoding instead of querying
+    if (argc == 3 && string(argv[1]) == "drift") {
+        return reportDecodeDrift(argv[2], decode, magnitudeWeighted);
+    }
     if (argc < 4) {
-        cerr << "Usage: " << argv[0] << " <target_image_path> <database_dir_path> <N>" << endl;
+        cerr << "Usage: " << argv[0] << " [--threads N] [--reduce 2|4|8 | --max-side N] [--magnitude-weighted] <target_image_path> <database_dir_path|index_file> <N>" << endl;
+        cerr << "       " << argv[0] << " [--threads N] [--reduce 2|4|8 | --max-side N] [--magnitude-weighted] index <database_dir_path> <index_file>" << endl;
+        cerr << "       " << argv[0] << " [--threads N] [--reduce 2|4|8 | --max-side N] [--magnitude-weighted] update <database_dir_path> <index_file>" << endl;
+        cerr << "       " << argv[0] << " (--reduce 2|4|8 | --max-side N) [--magnitude-weighted] drift <database_dir_path>" << endl;
         return 1;
     }
 
-    // Read target image
-    Mat targetImage = imread(argv[1]);
+    // Images are spread over the pool and pipeline, so keep OpenCV's own threads out of the way
+    setNumThreads(1);
+    ThreadPool pool(threads);
+    PipelineOptions stages = pipelineOptionsFor(threads);
+
+    // Build or update the feature index instead of querying
+    if (string(argv[1]) == "index" || string(argv[1]) == "update") {
+        return buildIndex(argv[2], argv[3], stages, decode, magnitudeWeighted, string(argv[1]) == "update");
+    }
+
+    Stopwatch stopwatch;
+
+    // Decode the target the same way as the database so both histograms see the same scale
+    Mat targetImage = decodeImage(readFileBytes(argv[1]), decode);
     if (targetImage.empty()) {
         cerr << "Error: Unable to read target image." << endl;
         return 1;
@@ -123,49 +199,92 @@ int main(int argc, char* argv[]) {
     Mat hist_target_color = computeColorHistogram(targetImage, 8);
 
     // Compute texture histogram for target image
-    Mat hist_target_texture = computeTextureHistogram(targetImage, 8);
+    Mat hist_target_texture = computeTextureHistogram(targetImage, 8, magnitudeWeighted);
+
+    double targetMillis = stopwatch.millis();
 
     // Read database directory
     string databaseDirPath = argv[2];
     int N = atoi(argv[3]);
 
-    // Vector to store distances and file paths
-    vector<pair<double, string>> distances;
+    // Each worker keeps only its N closest images, identified by position in imagePaths;
+    // each kept match carries its per-histogram distances for the headless output
+    vector<string> imagePaths;
+    vector<TopN<ScoredRow<2>>> partials;
 
-    // Iterate over images in the database directory
-    for (const auto& entry : fs::directory_iterator(databaseDirPath)) {
-        // Read image
-        Mat image = imread(entry.path().string());
-        if (image.empty()) {
-            cerr << "Error: Unable to read image " << entry.path().string() << endl;
-            continue;
+    // Compare against a prebuilt index when one is given instead of a directory
+    if (fs::is_regular_file(databaseDirPath) && isFeatureIndexFile(databaseDirPath)) {
+        FeatureIndex index;
+        if (!loadFeatureIndex(databaseDirPath, decodeKind(indexKind(magnitudeWeighted), decode), kIndexDimension, sizeof(float), index)) {
+            return 1;
+        }
+        partials = parallelScan(pool, index.size(), TopN<ScoredRow<2>>(N), [&](size_t i, TopN<ScoredRow<2>>& best) {
+            float* row = const_cast<float*>(index.row(i));
+            int colorSizes[] = { 8, 8, 8 };
+            Mat hist_color(3, colorSizes, CV_32F, row);
+            Mat hist_texture(8, 1, CV_32F, row + 8 * 8 * 8);
+            ScoredRow<2> match;
+            match.row = i;
+            double distance = computeMultiHistogramDistance(hist_target_color, hist_color, hist_target_texture, hist_texture, match.components);
+            best.push(distance, match);
+        });
+        imagePaths.swap(index.paths);
+    } else {
+        // Otherwise stream the database directory through the read/decode/extract pipeline
+        for (const auto& entry : fs::directory_iterator(databaseDirPath)) {
+            imagePaths.push_back(entry.path().string());
         }
+        partials.assign(stages.extractors, TopN<ScoredRow<2>>(N));
+        runPipeline(imagePaths.size(), stages, [&](size_t i) { return readFileBytes(imagePaths[i]); },
+                    [&](vector<uchar>& bytes) { return decodeImage(bytes, decode); },
+                    [&](int worker, size_t i, Mat& image) {
+            TopN<ScoredRow<2>>& best = partials[worker];
+            if (image.empty()) {
+                cerr << "Error: Unable to read image " << imagePaths[i] << endl;
+                return;
+            }
 
-        // Compute color histogram for current image
-        Mat hist_color = computeColorHistogram(image, 8);
+            // Compute color histogram for current image
+            Mat hist_color = computeColorHistogram(image, 8);
 
-        // Compute texture histogram for current image
-        Mat hist_texture = computeTextureHistogram(image, 8);
+            // Compute texture histogram for current image
+            Mat hist_texture = computeTextureHistogram(image, 8, magnitudeWeighted);
 
-        // Compute multi-histogram distance
-        double distance = computeMultiHistogramDistance(hist_target_color, hist_color, hist_target_texture, hist_texture);
+            // Compute multi-histogram distance
+            ScoredRow<2> match;
+            match.row = i;
+            double distance = computeMultiHistogramDistance(hist_target_color, hist_color, hist_target_texture, hist_texture, match.components);
 
-        // Store distance and file path
-        distances.push_back(make_pair(distance, entry.path().string()));
+            // Keep the distance if it is among the N closest so far
+            best.push(distance, match);
+        });
     }
 
-    // Sort images based on distances
-    sort(distances.begin(), distances.end());
+    // Merge the per-thread results, closest first
+    vector<TopN<ScoredRow<2>>::Entry> distances = mergeTopN(partials).sorted();
+
+    // Print machine-readable results without touching the GUI or decoding the matches again
+    if (headless) {
+        double totalMillis = stopwatch.millis();
+        NamedValues timings = { { "target", targetMillis }, { "scan", totalMillis - targetMillis }, { "total", totalMillis } };
+        for (size_t i = 0; i < distances.size(); ++i) {
+            const array<double, 2>& parts = distances[i].id.components;
+            NamedValues componentDistances = { { "color", parts[0] }, { "texture", parts[1] } };
+            writeResultRecord(cout, argv[1], i + 1, imagePaths[distances[i].id.row], distances[i].distance, componentDistances, timings);
+        }
+        return 0;
+    }
 
     // Display the top N images
-for (int i = 0; i < min(N, (int)distances.size()); ++i) {
+for (size_t i = 0; i < distances.size(); ++i) {
     // Load and display the image
-    Mat image = imread(distances[i].second);
+    const string& imagePath = imagePaths[distances[i].id.row];
+    Mat image = imread(imagePath);
     if (!image.empty()) {
         imshow("Image " + to_string(i + 1), image);
-        cout << "Distance: " << distances[i].first << ", Image: " << distances[i].second << endl;
+        cout << "Distance: " << distances[i].distance << ", Image: " << imagePath << endl;
     } else {
-        cerr << "Error: Unable to read image " << distances[i].second << endl;
+        cerr << "Error: Unable to read image " << imagePath << endl;
     }
 }
 waitKey(0); // Wait for a key press to exit
@@ -5,108 +5,648 @@ Date: 01/26/2024
 
 */
 
+#include <algorithm>
 #include <iostream>
 #include <vector>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <memory>
 #include <fstream>
+#include <cmath>
+#include <cstdlib>
 #include <boost/filesystem.hpp>
 #include <opencv2/opencv.hpp>
+#include "binaryIndex.h"
+#include "cliOptions.h"
+#include "dotKernels.h"
+#include "embeddingStore.h"
+#include "featureCsv.h"
+#include "hnswIndex.h"
+#include "int8Index.h"
+#include "ivfIndex.h"
+#include "parallelScan.h"
+#include "pcaIndex.h"
+#include "pqIndex.h"
+#include "resultWriter.h"
+#include "topN.h"
 
 using namespace std;
 using namespace cv;
 namespace fs = boost::filesystem;
 
-// Function to compute cosine distance between two feature vectors
-double computeCosineDistance(const Mat& vec1, const Mat& vec2) {
-    double dotProduct = vec1.dot(vec2);
-    double normVec1 = norm(vec1);
-    double normVec2 = norm(vec2);
-    return 1.0 - dotProduct / (normVec1 * normVec2);
+// Rows scored by one matrix-vector product in a scan
+const size_t kScanBlockRows = 256;
+
+// Function to rank count rows by cosine distance to row target, closest first. The
+// target is scaled to unit length once, so with normalized rows a distance is one dot product
+vector<TopN<size_t>::Entry> rankByCosineDistance(const float* rows, size_t count, size_t dimension, bool rowsNormalized,
+                                                 size_t target, int N, ThreadPool& pool) {
+    vector<float> query(dimension);
+    normalizeVector(rows + target * dimension, query.data(), dimension);
+
+    // Each worker keeps its own N closest rows
+    size_t blocks = (count + kScanBlockRows - 1) / kScanBlockRows;
+    vector<TopN<size_t>> partials = parallelScan(pool, blocks, TopN<size_t>(N), [&](size_t block, TopN<size_t>& best) {
+        size_t first = block * kScanBlockRows;
+        size_t blockRows = min(kScanBlockRows, count - first);
+        float distances[kScanBlockRows];
+        cosineDistances(rows + first * dimension, blockRows, dimension, query.data(), rowsNormalized, distances);
+        for (size_t k = 0; k < blockRows; ++k) {
+            best.push(distances[k], first + k);
+        }
+    }, 4);
+
+    // Merge the per-thread results, closest first
+    return mergeTopN(partials).sorted();
 }
 
-int main(int argc, char* argv[]) {
-    if (argc < 4) {
-        cerr << "Usage: " << argv[0] << " <feature_vectors_csv_path> <target_image_filename> <N>" << endl;
+// Function to convert the feature-vector CSV into a binary embedding store,
+// parsing the CSV on the pool while rows are written in file order
+int convertCsv(const string& csvFilePath, const string& storePath, ThreadPool& pool) {
+    EmbeddingStoreWriter writer;
+    bool opened = false;
+    bool parsed = forEachFeatureCsvChunk(csvFilePath, pool, [&](const FeatureRows& rows) {
+        // The first row fixes the dimension for the whole store
+        if (!opened && !writer.open(storePath, rows.dimension)) {
+            return false;
+        }
+        opened = true;
+        for (size_t i = 0; i < rows.size(); ++i) {
+            writer.append(rows.name(i), rows.row(i));
+        }
+        return true;
+    });
+    if (!parsed) {
+        if (opened) {
+            writer.abandon();
+        }
         return 1;
     }
+    if (!writer.finish()) {
+        return 1;
+    }
+    cout << "Converted " << writer.size() << " feature vectors into " << storePath << endl;
+    return 0;
+}
+
+// Settings of the approximate indexes, from the command line
+struct AnnOptions {
+    string indexPath;      // --index: approximate index to query instead of scanning the store
+    size_t listCount = 0;  // --nlist: IVF cells, 0 picks 4 * sqrt(rows)
+    size_t nprobe = 8;     // --nprobe: IVF cells scanned per query
+    HnswOptions hnsw;      // --m, --ef-construction, --ef-search: HNSW graph settings
+    size_t subquantizers = 64;  // --subquantizers: PQ code bytes per row
+    size_t rerank = 0;          // --rerank: PQ, int8, binary or PCA candidates re-scored against the store rows, 0 keeps their distances
+    size_t bits = 512;          // --bits: binary hash length
+    size_t components = 128;    // --components: PCA dimensions kept
+    bool whiten = false;        // --whiten: scale PCA axes to unit variance
+};
 
-    // Read target image's feature vector from the CSV file
-    string csvFilePath = argv[1];
-    string targetImageFilename = argv[2];
-    int N = atoi(argv[3]);
+// Approximate search over the rows of a store: a unit-length query in, the N closest rows out
+typedef function<vector<TopN<size_t>::Entry>(const float*, int)> ApproximateSearch;
 
-    // Read target image's feature vector from the CSV file
-    Mat targetFeatureVector;
-    ifstream csvFile(csvFilePath);
-    if (!csvFile.is_open()) {
-        cerr << "Error: Unable to open CSV file." << endl;
+// Function to build an IVF index over the rows of an embedding store
+int buildIvf(const string& storePath, const string& ivfPath, const AnnOptions& options, ThreadPool& pool) {
+    EmbeddingStore store;
+    if (!store.open(storePath)) {
         return 1;
     }
-    string line;
-    while (getline(csvFile, line)) {
-        istringstream iss(line);
-        vector<string> tokens;
-        string token;
-        while (getline(iss, token, ',')) {
-            tokens.push_back(token);
-        }
-        if (tokens.size() < 2) {
-            cerr << "Error: Invalid CSV format." << endl;
-            return 1;
-        }
-        if (tokens[0] == targetImageFilename) {
-            tokens.erase(tokens.begin());
-            vector<float> values;
-            for (const string& val : tokens) {
-                values.push_back(stof(val));
-            }
-            targetFeatureVector = Mat(values, true).reshape(1, 1);
-            break;
+    size_t listCount = options.listCount > 0 ? options.listCount : static_cast<size_t>(4 * sqrt(static_cast<double>(store.size())));
+    IvfIndex index;
+    if (!buildIvfIndex(store.row(0), store.size(), store.dimension(), listCount, pool, index)) {
+        return 1;
+    }
+    index.storeFingerprint = store.fingerprint();
+    if (!saveIvfIndex(index, ivfPath)) {
+        return 1;
+    }
+    cout << "Filed " << index.rowCount << " feature vectors under " << index.listCount << " IVF lists in " << ivfPath << endl;
+    return 0;
+}
+
+// Function to build an HNSW graph over the rows of an embedding store
+int buildHnsw(const string& storePath, const string& hnswPath, const AnnOptions& options, ThreadPool& pool) {
+    EmbeddingStore store;
+    if (!store.open(storePath)) {
+        return 1;
+    }
+    Stopwatch stopwatch;
+    HnswIndex index;
+    if (!index.build(store.row(0), store.size(), store.dimension(), store.normalized(), options.hnsw, pool)) {
+        return 1;
+    }
+    index.setStoreFingerprint(store.fingerprint());
+    double buildMillis = stopwatch.millis();
+    if (!index.save(hnswPath)) {
+        return 1;
+    }
+    cout << "Linked " << index.size() << " feature vectors into an HNSW graph in " << hnswPath << " (" << buildMillis << " ms)" << endl;
+    return 0;
+}
+
+// Function to build PQ codes for the rows of an embedding store
+int buildPq(const string& storePath, const string& pqPath, const AnnOptions& options, ThreadPool& pool) {
+    EmbeddingStore store;
+    if (!store.open(storePath)) {
+        return 1;
+    }
+    PqIndex index;
+    buildPqIndex(store.row(0), store.size(), store.dimension(), options.subquantizers, pool, index);
+    index.storeFingerprint = store.fingerprint();
+    if (!savePqIndex(index, pqPath)) {
+        return 1;
+    }
+    cout << "Encoded " << index.rowCount << " feature vectors as " << index.subquantizerCount << "-byte PQ codes in " << pqPath << endl;
+    return 0;
+}
+
+// Function to quantize the rows of an embedding store to int8 codes
+int buildInt8(const string& storePath, const string& int8Path, ThreadPool& pool) {
+    EmbeddingStore store;
+    if (!store.open(storePath)) {
+        return 1;
+    }
+    Int8Index index;
+    buildInt8Index(store.row(0), store.size(), store.dimension(), pool, index);
+    index.storeFingerprint = store.fingerprint();
+    if (!saveInt8Index(index, int8Path)) {
+        return 1;
+    }
+    cout << "Quantized " << index.rowCount << " feature vectors to int8 codes in " << int8Path << endl;
+    return 0;
+}
+
+// Function to hash the rows of an embedding store into binary sign hashes
+int buildBinary(const string& storePath, const string& binaryPath, const AnnOptions& options, ThreadPool& pool) {
+    EmbeddingStore store;
+    if (!store.open(storePath)) {
+        return 1;
+    }
+    BinaryIndex index;
+    buildBinaryIndex(store.row(0), store.size(), store.dimension(), options.bits, pool, index);
+    index.storeFingerprint = store.fingerprint();
+    if (!saveBinaryIndex(index, binaryPath)) {
+        return 1;
+    }
+    cout << "Hashed " << index.rowCount << " feature vectors to " << index.bitCount << "-bit sign hashes in " << binaryPath << endl;
+    return 0;
+}
+
+// Function to train a PCA projection of the rows of an embedding store and store the reduced rows
+int buildPca(const string& storePath, const string& pcaPath, const AnnOptions& options, ThreadPool& pool) {
+    EmbeddingStore store;
+    if (!store.open(storePath)) {
+        return 1;
+    }
+    PcaIndex index;
+    buildPcaIndex(store.row(0), store.size(), store.dimension(), options.components, options.whiten, pool, index);
+    index.storeFingerprint = store.fingerprint();
+    if (!savePcaIndex(index, pcaPath)) {
+        return 1;
+    }
+    cout << "Projected " << index.rowCount << " feature vectors from " << index.sourceDimension << " to " << index.dimension
+         << (index.whitened ? " whitened" : "") << " dimensions in " << pcaPath << " (" << 100.0 * index.retainedVariance
+         << "% of the variance retained)" << endl;
+    return 0;
+}
+
+// Function to check that an index was built from this store: same shape, same store fingerprint
+bool builtFromStore(const EmbeddingStore& store, const string& kind, const string& indexPath,
+                    uint64_t dimension, uint64_t rowCount, uint64_t fingerprint) {
+    if (dimension != store.dimension() || rowCount != store.size() || fingerprint != store.fingerprint()) {
+        cerr << "Error: " << kind << " index " << indexPath << " was built from a different embedding store." << endl;
+        return false;
+    }
+    return true;
+}
+
+// Function to wrap an index whose scan takes --rerank and the pool, as PQ, int8,
+// binary and PCA searches do, into a search over the store's rows
+template<typename Index, typename SearchIndex>
+ApproximateSearch rerankedSearch(const EmbeddingStore& store, shared_ptr<Index> index, SearchIndex searchIndex,
+                                 size_t rerank, ThreadPool& pool) {
+    const float* rows = store.row(0);
+    bool rowsNormalized = store.normalized();
+    ThreadPool* scanPool = &pool;
+    return [index, searchIndex, rows, rowsNormalized, rerank, scanPool](const float* unitQuery, int N) {
+        return searchIndex(*index, rows, rowsNormalized, unitQuery, N, rerank, *scanPool);
+    };
+}
+
+// Function to load the approximate index in options.indexPath for a store, picking the kind from its magic
+bool openApproximateSearch(const EmbeddingStore& store, const AnnOptions& options, ThreadPool& pool, ApproximateSearch& search) {
+    const string& path = options.indexPath;
+    if (isIvfIndexFile(path)) {
+        shared_ptr<IvfIndex> index = make_shared<IvfIndex>();
+        if (!loadIvfIndex(path, *index) ||
+            !builtFromStore(store, "IVF", path, index->dimension, index->rowCount, index->storeFingerprint)) {
+            return false;
         }
+        const float* rows = store.row(0);
+        bool rowsNormalized = store.normalized();
+        size_t nprobe = options.nprobe;
+        search = [index, rows, rowsNormalized, nprobe](const float* unitQuery, int N) {
+            return searchIvfIndex(*index, rows, rowsNormalized, unitQuery, N, nprobe);
+        };
+        return true;
     }
-    csvFile.close();
-    if (targetFeatureVector.empty()) {
+    if (isHnswIndexFile(path)) {
+        shared_ptr<HnswIndex> index = make_shared<HnswIndex>();
+        if (!index->load(path) ||
+            !builtFromStore(store, "HNSW", path, index->dimension(), index->size(), index->storeFingerprint())) {
+            return false;
+        }
+        index->attach(store.row(0), store.normalized());
+        size_t efSearch = options.hnsw.efSearch;
+        search = [index, efSearch](const float* unitQuery, int N) {
+            return index->search(unitQuery, N, efSearch);
+        };
+        return true;
+    }
+    if (isPqIndexFile(path)) {
+        shared_ptr<PqIndex> index = make_shared<PqIndex>();
+        if (!loadPqIndex(path, *index) ||
+            !builtFromStore(store, "PQ", path, index->dimension, index->rowCount, index->storeFingerprint)) {
+            return false;
+        }
+        search = rerankedSearch(store, index, searchPqIndex, options.rerank, pool);
+        return true;
+    }
+    if (isInt8IndexFile(path)) {
+        shared_ptr<Int8Index> index = make_shared<Int8Index>();
+        if (!loadInt8Index(path, *index) ||
+            !builtFromStore(store, "int8", path, index->dimension, index->rowCount, index->storeFingerprint)) {
+            return false;
+        }
+        search = rerankedSearch(store, index, searchInt8Index, options.rerank, pool);
+        return true;
+    }
+    if (isBinaryIndexFile(path)) {
+        shared_ptr<BinaryIndex> index = make_shared<BinaryIndex>();
+        if (!loadBinaryIndex(path, *index) ||
+            !builtFromStore(store, "Binary", path, index->dimension, index->rowCount, index->storeFingerprint)) {
+            return false;
+        }
+        search = rerankedSearch(store, index, searchBinaryIndex, options.rerank, pool);
+        return true;
+    }
+    if (isPcaIndexFile(path)) {
+        shared_ptr<PcaIndex> index = make_shared<PcaIndex>();
+        if (!loadPcaIndex(path, *index) ||
+            !builtFromStore(store, "PCA", path, index->sourceDimension, index->rowCount, index->storeFingerprint)) {
+            return false;
+        }
+        search = rerankedSearch(store, index, searchPcaIndex, options.rerank, pool);
+        return true;
+    }
+    cerr << "Error: " << path << " is not a supported approximate index." << endl;
+    return false;
+}
+
+// Function to rank the database using a memory-mapped embedding store
+int queryStore(const string& storePath, const string& targetImageFilename, int N, ThreadPool& pool, bool headless,
+               const AnnOptions& options) {
+    Stopwatch stopwatch;
+    EmbeddingStore store;
+    ApproximateSearch search;
+    if (!store.open(storePath) || (!options.indexPath.empty() && !openApproximateSearch(store, options, pool, search))) {
+        return 1;
+    }
+    long target = store.find(targetImageFilename);
+    if (target < 0) {
         cerr << "Error: Feature vector not found for target image." << endl;
         return 1;
     }
 
-    // Read feature vectors for database images from the CSV file and compute distances
-    vector<pair<double, string>> distances;
-    csvFile.open(csvFilePath);
-    if (!csvFile.is_open()) {
-        cerr << "Error: Unable to open CSV file." << endl;
+    // Ask the approximate index when one is given, otherwise scan the rows in place in the mapping
+    vector<TopN<size_t>::Entry> distances;
+    if (search) {
+        vector<float> query(store.dimension());
+        normalizeVector(store.row(target), query.data(), query.size());
+        distances = search(query.data(), N);
+    } else {
+        distances = rankByCosineDistance(store.row(0), store.size(), store.dimension(), store.normalized(), target, N, pool);
+    }
+
+    // Print machine-readable results when running headless
+    if (headless) {
+        NamedValues timings = { { "total", stopwatch.millis() } };
+        for (size_t i = 0; i < distances.size(); ++i) {
+            writeResultRecord(cout, targetImageFilename, i + 1, string(store.name(distances[i].id)), distances[i].distance, NamedValues(), timings);
+        }
+        return 0;
+    }
+
+    // Display the top N images
+    for (const auto& match : distances) {
+        cout << "Distance: " << match.distance << ", Image: " << store.name(match.id) << endl;
+    }
+
+    return 0;
+}
+
+// Function to rank the database straight from the feature-vector CSV. The file
+// is parsed once on the pool into memory, then the target is looked up and scored
+int queryCsv(const string& csvFilePath, const string& targetImageFilename, int N, ThreadPool& pool, bool headless) {
+    Stopwatch stopwatch;
+    FeatureRows rows;
+    if (!loadFeatureCsv(csvFilePath, pool, rows)) {
+        return 1;
+    }
+    long target = rows.find(targetImageFilename);
+    if (target < 0) {
+        cerr << "Error: Feature vector not found for target image." << endl;
         return 1;
     }
-    while (getline(csvFile, line)) {
-        istringstream iss(line);
-        vector<string> tokens;
-        string token;
-        while (getline(iss, token, ',')) {
-            tokens.push_back(token);
+
+    // The parsed rows are not normalized, so their lengths are divided out during the scan
+    vector<TopN<size_t>::Entry> distances = rankByCosineDistance(rows.row(0), rows.size(), rows.dimension, false, target, N, pool);
+
+    // Print machine-readable results when running headless
+    if (headless) {
+        NamedValues timings = { { "total", stopwatch.millis() } };
+        for (size_t i = 0; i < distances.size(); ++i) {
+            writeResultRecord(cout, targetImageFilename, i + 1, string(rows.name(distances[i].id)), distances[i].distance, NamedValues(), timings);
+        }
+        return 0;
+    }
+
+    // Display the top N images
+    for (const auto& match : distances) {
+        cout << "Distance: " << match.distance << ", Image: " << rows.name(match.id) << endl;
+    }
+
+    return 0;
+}
+
+// Tile of the batched scan: 64 database rows against 64 queries, which for
+// 512-d vectors keeps both blocks (128 KB each) in L2 while they are scored
+const size_t kBatchBlockRows = 64;
+const size_t kBatchBlockQueries = 64;
+
+// Function to rank count rows against every unit-length query at once, closest first per query.
+// Each worker takes blocks of rows and scores them against all queries as one blocked
+// matrix product, so every row is read from memory once per batch instead of once per query
+vector<vector<TopN<size_t>::Entry>> rankBatchByCosineDistance(const float* rows, size_t count, size_t dimension, bool rowsNormalized,
+                                                              const vector<float>& queries, size_t queryCount, int N, ThreadPool& pool) {
+    size_t blocks = (count + kBatchBlockRows - 1) / kBatchBlockRows;
+    vector<TopN<size_t>> initial(queryCount, TopN<size_t>(N));
+    vector<vector<TopN<size_t>>> partials = parallelScan(pool, blocks, initial, [&](size_t block, vector<TopN<size_t>>& best) {
+        size_t first = block * kBatchBlockRows;
+        size_t blockRows = min(kBatchBlockRows, count - first);
+        const float* blockData = rows + first * dimension;
+
+        // Rows that are not unit length have their own length divided out
+        float scale[kBatchBlockRows];
+        for (size_t r = 0; r < blockRows; ++r) {
+            const float* row = blockData + r * dimension;
+            scale[r] = rowsNormalized ? 1.0f : inverseRowLength(row, dimension);
         }
-        if (tokens.size() < 513) {
-            cerr << "Error: Invalid CSV format." << endl;
-            return 1;
+
+        float similarities[kBatchBlockQueries * kBatchBlockRows];
+        for (size_t q0 = 0; q0 < queryCount; q0 += kBatchBlockQueries) {
+            size_t blockQueries = min(kBatchBlockQueries, queryCount - q0);
+            matrixProductTransposed(queries.data() + q0 * dimension, blockQueries, blockData, blockRows, dimension, similarities);
+            for (size_t q = 0; q < blockQueries; ++q) {
+                TopN<size_t>& heap = best[q0 + q];
+                const float* similarity = similarities + q * blockRows;
+                for (size_t r = 0; r < blockRows; ++r) {
+                    double distance = 1.0 - similarity[r] * scale[r];
+                    if (heap.accepts(distance)) {
+                        heap.push(distance, first + r);
+                    }
+                }
+            }
         }
-        string filename = tokens[0];
-        tokens.erase(tokens.begin());
-        vector<float> values;
-        for (const string& val : tokens) {
-            values.push_back(stof(val));
+    }, 1);
+
+    // Merge the per-thread results of each query, closest first
+    vector<vector<TopN<size_t>::Entry>> results(queryCount);
+    vector<TopN<size_t>> perWorker(partials.size());
+    for (size_t q = 0; q < queryCount; ++q) {
+        for (size_t worker = 0; worker < partials.size(); ++worker) {
+            perWorker[worker] = partials[worker][q];
         }
-        Mat featureVector = Mat(values, true).reshape(1, 1);
-        double distance = computeCosineDistance(targetFeatureVector, featureVector);
-        distances.push_back(make_pair(distance, filename));
+        results[q] = mergeTopN(perWorker).sorted();
     }
-    csvFile.close();
+    return results;
+}
 
-    // Sort images based on distances
-    sort(distances.begin(), distances.end());
+// Function to read the target filenames of a batch, one per line
+bool readTargetList(const string& path, vector<string>& targets) {
+    ifstream in(path);
+    if (!in.is_open()) {
+        cerr << "Error: Unable to open target list " << path << endl;
+        return false;
+    }
+    string line;
+    while (getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (!line.empty()) {
+            targets.push_back(line);
+        }
+    }
+    return true;
+}
 
-    // Display the top N images
-    for (int i = 0; i < min(N, static_cast<int>(distances.size())); ++i) {
-        cout << "Distance: " << distances[i].first << ", Image: " << distances[i].second << endl;
+// Function to rank the database for a whole list of targets in one scan of the
+// embedding store or CSV; targets without a feature vector are reported and skipped
+int queryBatch(const string& databasePath, const string& targetsPath, int N, ThreadPool& pool, bool headless) {
+    Stopwatch stopwatch;
+    vector<string> targets;
+    if (!readTargetList(targetsPath, targets)) {
+        return 1;
+    }
+
+    // The store stays mapped and a CSV is parsed into memory; both give contiguous rows
+    EmbeddingStore store;
+    FeatureRows csvRows;
+    bool useStore = isEmbeddingStoreFile(databasePath);
+    if (useStore ? !store.open(databasePath) : !loadFeatureCsv(databasePath, pool, csvRows)) {
+        return 1;
+    }
+    const float* rows = useStore ? store.row(0) : csvRows.row(0);
+    size_t count = useStore ? store.size() : csvRows.size();
+    size_t dimension = useStore ? store.dimension() : csvRows.dimension;
+    auto nameOf = [&](size_t i) { return useStore ? store.name(i) : csvRows.name(i); };
+
+    // Look every target up by name once instead of scanning the names per target
+    unordered_map<string_view, size_t> rowOf;
+    for (size_t i = 0; i < count; ++i) {
+        rowOf.emplace(nameOf(i), i);
+    }
+    vector<string> queryNames;
+    vector<float> queries;
+    for (const string& target : targets) {
+        auto found = rowOf.find(target);
+        if (found == rowOf.end()) {
+            cerr << "Error: Feature vector not found for target image " << target << "." << endl;
+            continue;
+        }
+        queryNames.push_back(target);
+        queries.resize(queries.size() + dimension);
+        normalizeVector(rows + found->second * dimension, queries.data() + queries.size() - dimension, dimension);
+    }
+    if (queryNames.empty()) {
+        cerr << "Error: None of the targets has a feature vector." << endl;
+        return 1;
+    }
+
+    double loadMillis = stopwatch.millis();
+    vector<vector<TopN<size_t>::Entry>> results = rankBatchByCosineDistance(rows, count, dimension, useStore && store.normalized(),
+                                                                            queries, queryNames.size(), N, pool);
+
+    // Print machine-readable results when running headless
+    if (headless) {
+        double totalMillis = stopwatch.millis();
+        NamedValues timings = { { "load", loadMillis }, { "scan", totalMillis - loadMillis }, { "total", totalMillis } };
+        for (size_t q = 0; q < results.size(); ++q) {
+            for (size_t i = 0; i < results[q].size(); ++i) {
+                writeResultRecord(cout, queryNames[q], i + 1, string(nameOf(results[q][i].id)), results[q][i].distance, NamedValues(), timings);
+            }
+        }
+        return 0;
+    }
+
+    // Display the top N images of every target
+    for (size_t q = 0; q < results.size(); ++q) {
+        cout << "Target: " << queryNames[q] << endl;
+        for (const auto& match : results[q]) {
+            cout << "Distance: " << match.distance << ", Image: " << nameOf(match.id) << endl;
+        }
     }
 
     return 0;
 }
+
+// Function to measure how many of the exact N closest rows an approximate index
+// finds, over up to 200 targets spread evenly through the store
+int measureRecall(const string& storePath, const AnnOptions& options, int N, ThreadPool& pool) {
+    EmbeddingStore store;
+    ApproximateSearch search;
+    if (!store.open(storePath) || !openApproximateSearch(store, options, pool, search)) {
+        return 1;
+    }
+    size_t dimension = store.dimension();
+    size_t queryCount = min<size_t>(200, store.size());
+    vector<float> queries(queryCount * dimension);
+    for (size_t q = 0; q < queryCount; ++q) {
+        normalizeVector(store.row(q * store.size() / queryCount), queries.data() + q * dimension, dimension);
+    }
+
+    // Exact answers come from one batched scan
+    vector<vector<TopN<size_t>::Entry>> exact = rankBatchByCosineDistance(store.row(0), store.size(), dimension, store.normalized(),
+                                                                          queries, queryCount, N, pool);
+    size_t found = 0, expected = 0;
+    Stopwatch stopwatch;
+    for (size_t q = 0; q < queryCount; ++q) {
+        vector<TopN<size_t>::Entry> approximate = search(queries.data() + q * dimension, N);
+        unordered_set<size_t> returned;
+        for (const auto& match : approximate) {
+            returned.insert(match.id);
+        }
+        for (const auto& match : exact[q]) {
+            found += returned.count(match.id);
+        }
+        expected += exact[q].size();
+    }
+    double millisPerQuery = stopwatch.millis() / queryCount;
+    cout << "Recall@" << N << ": " << (expected > 0 ? static_cast<double>(found) / expected : 0.0) << " over " << queryCount
+         << " targets, " << millisPerQuery << " ms per query" << endl;
+    return 0;
+}
+
+// Function to print every command line Question5 accepts
+void printUsage(const char* program) {
+    cerr << "Usage: " << program << " [--threads N] [--headless] <feature_vectors_csv_path|embedding_store> <target_image_filename> <N>" << endl;
+    cerr << "       " << program << " [--threads N] [--headless] batch <feature_vectors_csv_path|embedding_store> <target_list_file> <N>" << endl;
+    cerr << "       " << program << " [--threads N] convert <feature_vectors_csv_path> <embedding_store>" << endl;
+    cerr << "       " << program << " [--threads N] [--headless] --index <ann_index> [--nprobe P] [--ef-search E] [--rerank R] <embedding_store> <target_image_filename> <N>" << endl;
+    cerr << "       " << program << " [--threads N] [--nlist K] ivf <embedding_store> <ivf_index>" << endl;
+    cerr << "       " << program << " [--threads N] [--m M] [--ef-construction E] hnsw <embedding_store> <hnsw_index>" << endl;
+    cerr << "       " << program << " [--threads N] [--subquantizers S] pq <embedding_store> <pq_index>" << endl;
+    cerr << "       " << program << " [--threads N] int8 <embedding_store> <int8_index>" << endl;
+    cerr << "       " << program << " [--threads N] [--bits B] binary <embedding_store> <binary_index>" << endl;
+    cerr << "       " << program << " [--threads N] [--components K] [--whiten] pca <embedding_store> <pca_index>" << endl;
+    cerr << "       " << program << " [--threads N] [--nprobe P] [--ef-search E] [--rerank R] recall <embedding_store> <ann_index> <N>" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    int threads = 0;
+    if (!takeThreadCount(argc, argv, threads)) {
+        return 1;
+    }
+    bool headless = takeFlag(argc, argv, "--headless");
+    AnnOptions ann;
+    ann.indexPath = takeOption(argc, argv, "--index", "");
+    if (!takeCountOption(argc, argv, "--nlist", 0, ann.listCount) ||
+        !takeCountOption(argc, argv, "--nprobe", 8, ann.nprobe) ||
+        !takeCountOption(argc, argv, "--m", 16, ann.hnsw.M) ||
+        !takeCountOption(argc, argv, "--ef-construction", 200, ann.hnsw.efConstruction) ||
+        !takeCountOption(argc, argv, "--ef-search", 64, ann.hnsw.efSearch) ||
+        !takeCountOption(argc, argv, "--subquantizers", 64, ann.subquantizers) ||
+        !takeCountOption(argc, argv, "--rerank", 0, ann.rerank) ||
+        !takeCountOption(argc, argv, "--bits", 512, ann.bits) ||
+        !takeCountOption(argc, argv, "--components", 128, ann.components)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    ann.whiten = takeFlag(argc, argv, "--whiten");
+    // Every command is recognized by name first, then its argument count is checked
+    string command = argc > 1 ? argv[1] : "";
+    int expectedArgc = command == "batch" || command == "recall" ? 5 : 4;
+    if (argc != expectedArgc) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // Rank a list of targets in one pass over the database
+    ThreadPool pool(threads);
+    if (command == "batch") {
+        return queryBatch(argv[2], argv[3], atoi(argv[4]), pool, headless);
+    }
+
+    // Build an approximate index, or measure one against the exact ranking
+    if (command == "ivf") {
+        return buildIvf(argv[2], argv[3], ann, pool);
+    }
+    if (command == "hnsw") {
+        return buildHnsw(argv[2], argv[3], ann, pool);
+    }
+    if (command == "pq") {
+        return buildPq(argv[2], argv[3], ann, pool);
+    }
+    if (command == "int8") {
+        return buildInt8(argv[2], argv[3], pool);
+    }
+    if (command == "binary") {
+        return buildBinary(argv[2], argv[3], ann, pool);
+    }
+    if (command == "pca") {
+        return buildPca(argv[2], argv[3], ann, pool);
+    }
+    if (command == "recall") {
+        ann.indexPath = argv[3];
+        return measureRecall(argv[2], ann, atoi(argv[4]), pool);
+    }
+
+    // Convert the CSV into a binary embedding store instead of querying
+    if (command == "convert") {
+        return convertCsv(argv[2], argv[3], pool);
+    }
+
+    // Query the embedding store when one is given, the CSV otherwise
+    if (isEmbeddingStoreFile(argv[1])) {
+        return queryStore(argv[1], argv[2], atoi(argv[3]), pool, headless, ann);
+    }
+    if (!ann.indexPath.empty()) {
+        cerr << "Error: --index needs an embedding store, see convert." << endl;
+        return 1;
+    }
+    return queryCsv(argv[1], argv[2], atoi(argv[3]), pool, headless);
+}
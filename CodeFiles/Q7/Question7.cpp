@@ -5,113 +5,152 @@ Date: 01/26/2024
 
 */
 
+#include <array>
 #include <iostream>
 #include <vector>
 #include <string>
 #include <fstream>
 #include <opencv2/opencv.hpp>
 #include <boost/filesystem.hpp>
+#include "chiSquared.h"
+#include "colorHistograms.h"
+#include "cliOptions.h"
+#include "dotKernels.h"
+#include "embeddingStore.h"
+#include "featureCsv.h"
+#include "int8Index.h"
+#include "parallelScan.h"
+#include "pcaIndex.h"
+#include "resultWriter.h"
+#include "topN.h"
 
 using namespace std;
 using namespace cv;
 namespace fs = boost::filesystem;
 
-// Function to compute cosine distance between two feature vectors
-double computeCosineDistance(const Mat& vec1, const Mat& vec2) {
-    double dotProduct = vec1.dot(vec2);
-    double normVec1 = norm(vec1);
-    double normVec2 = norm(vec2);
-    return 1.0 - dotProduct / (normVec1 * normVec2);
-}
-
 // Function to compute histogram intersection distance between two histograms
 double computeChiSquaredDistance(const Mat& hist1, const Mat& hist2) {
-    assert(hist1.size() == hist2.size());
-
-    double distance = 0.0;
-    for (int i = 0; i < hist1.rows; ++i) {
-        for (int j = 0; j < hist1.cols; ++j) {
-            double diff = hist1.at<float>(i, j) - hist2.at<float>(i, j);
-            double sum = hist1.at<float>(i, j) + hist2.at<float>(i, j);
-            if (sum != 0) {
-                distance += (diff * diff) / sum;
-            }
-        }
-    }
-
-    return distance;
+    return chiSquaredDistance(hist1, hist2);
 }
 
 // Function to compute RG chromaticity histogram for a given image
 Mat computeRGChromaticityHistogram(const Mat& image, int numBins) {
-    Mat hist;
-
-    Mat floatImage;
-    image.convertTo(floatImage, CV_32F);
-
-    Mat rgHist;
-    int histSize[] = { numBins, numBins };
-    float rRanges[] = { 0, 256 };
-    float gRanges[] = { 0, 256 };
-    const float* ranges[] = { rRanges, gRanges };
-    int channels[] = { 0, 1 };
-    try {
-        calcHist(&floatImage, 1, channels, Mat(), rgHist, 2, histSize, ranges, true, false);
-    } catch (const cv::Exception& e) {
-        cerr << "Error computing histogram: " << e.what() << endl;
-        return Mat();
+    // One pass over the 8-bit pixels, no float copy of the image
+    ColorHistogramSpec spec;
+    spec.rgBins = numBins;
+    return computeColorHistograms(image, spec).rg;
+}
+
+// Function to combine the precomputed feature distance with the histogram distance for one database image, keeping both in components
+bool computeCombinedDistance(double featureDistance, const Mat& targetHist, const string& databaseDir,
+                             const string& filename, double& combinedDistance, array<double, 2>& components) {
+    // Read and compute histogram for the current image
+    Mat image = imread(databaseDir + "/" + filename);
+    if (image.empty()) {
+        cerr << "Error: Unable to read image " << filename << endl;
+        return false;
+    }
+    Mat imageHist = computeRGChromaticityHistogram(image, 16);
+    if (imageHist.empty()) {
+        cerr << "Error: Unable to compute histogram for image " << filename << endl;
+        return false;
     }
 
-    normalize(rgHist, hist, 0, 1, NORM_MINMAX, -1, Mat());
+    // Compute histogram intersection distance between target and current image
+    double histDistance = computeChiSquaredDistance(targetHist, imageHist);
 
-    return hist;
+    // Combine distances using a weighted average or other strategies as needed
+    combinedDistance = (featureDistance + histDistance) / 2.0;
+    components = { featureDistance, histDistance };
+    return true;
 }
 
 int main(int argc, char* argv[]) {
-    if (argc < 5) {
-        cerr << "Usage: " << argv[0] << " <feature_vectors_csv_path> <target_image_path> <database_dir> <N>" << endl;
+    int threads = 0;
+    if (!takeThreadCount(argc, argv, threads)) {
+        return 1;
+    }
+    bool headless = takeFlag(argc, argv, "--headless");
+    string indexPath = takeOption(argc, argv, "--index", "");
+    size_t rerank = 0;
+    if (!takeCountOption(argc, argv, "--rerank", 0, rerank) || argc < 5) {
+        cerr << "Usage: " << argv[0] << " [--threads N] [--headless] <feature_vectors_csv_path|embedding_store> <target_image_path> <database_dir> <N>" << endl;
+        cerr << "       " << argv[0] << " [--threads N] [--headless] --index <int8_or_pca_index> [--rerank R] <embedding_store> <target_image_path> <database_dir> <N>" << endl;
         return 1;
     }
 
+    // Images are spread over the pool, so keep OpenCV's own threads out of the way
+    setNumThreads(1);
+    ThreadPool pool(threads);
+
     string csvFilePath = argv[1];
     string targetImagePath = argv[2];
     string databaseDir = argv[3];
     int N = atoi(argv[4]);
-
-    // Read target image's feature vector from the CSV file
-    Mat targetFeatureVector;
-    ifstream csvFile(csvFilePath);
-    if (!csvFile.is_open()) {
-        cerr << "Error: Unable to open CSV file." << endl;
+    Stopwatch stopwatch;
+
+    // The embedding store stays mapped for the whole scan; a CSV is parsed on the pool into memory
+    EmbeddingStore store;
+    FeatureRows csvRows;
+    bool useStore = isEmbeddingStoreFile(csvFilePath);
+
+    // Find the target image's feature vector in the embedding store or the CSV file
+    const float* rows = nullptr;
+    size_t count = 0, dimension = 0;
+    bool rowsNormalized = false;
+    long target = -1;
+    string targetFilename = fs::path(targetImagePath).filename().string();
+    if (useStore) {
+        if (!store.open(csvFilePath)) {
+            return 1;
+        }
+        rows = store.row(0);
+        count = store.size();
+        dimension = store.dimension();
+        rowsNormalized = store.normalized();
+        target = store.find(targetFilename);
+    } else {
+        if (!loadFeatureCsv(csvFilePath, pool, csvRows)) {
+            return 1;
+        }
+        rows = csvRows.row(0);
+        count = csvRows.size();
+        dimension = csvRows.dimension;
+        target = csvRows.find(targetFilename);
+    }
+    if (target < 0) {
+        cerr << "Error: Feature vector not found for target image." << endl;
         return 1;
     }
 
-    string line;
-    while (getline(csvFile, line)) {
-        istringstream iss(line);
-        vector<string> tokens;
-        string token;
-        while (getline(iss, token, ',')) {
-            tokens.push_back(token);
+    // int8 codes or PCA-reduced rows of the store, from Question5's int8 and pca commands
+    Int8Index int8Index;
+    PcaIndex pcaIndex;
+    bool useIndex = !indexPath.empty();
+    bool usePca = useIndex && isPcaIndexFile(indexPath);
+    if (useIndex) {
+        if (!useStore) {
+            cerr << "Error: --index needs an embedding store." << endl;
+            return 1;
+        }
+        if (!usePca && !isInt8IndexFile(indexPath)) {
+            cerr << "Error: --index takes an int8 or PCA index, see Question5's int8 and pca commands." << endl;
+            return 1;
         }
-        if (tokens.size() < 2) {
-            cerr << "Error: Invalid CSV format." << endl;
+        if (usePca ? !loadPcaIndex(indexPath, pcaIndex) : !loadInt8Index(indexPath, int8Index)) {
             return 1;
         }
-        if (tokens[0] == fs::path(targetImagePath).filename()) {
-            tokens.erase(tokens.begin());
-            vector<float> values;
-            for (const string& val : tokens) {
-                values.push_back(stof(val));
-            }
-            targetFeatureVector = Mat(values, true).reshape(1, 1);
-            break;
+        if (usePca && pcaIndex.whitened) {
+            cerr << "Error: PCA index " << indexPath << " is whitened, build it without --whiten for Question7." << endl;
+            return 1;
+        }
+        uint32_t indexDimension = usePca ? pcaIndex.sourceDimension : int8Index.dimension;
+        uint64_t indexRows = usePca ? pcaIndex.rowCount : int8Index.rowCount;
+        uint64_t indexFingerprint = usePca ? pcaIndex.storeFingerprint : int8Index.storeFingerprint;
+        if (indexDimension != dimension || indexRows != count || indexFingerprint != store.fingerprint()) {
+            cerr << "Error: Index " << indexPath << " was built from a different embedding store." << endl;
+            return 1;
         }
-    }
-    csvFile.close();
-    if (targetFeatureVector.empty()) {
-        cerr << "Error: Feature vector not found for target image." << endl;
-        return 1;
     }
 
     // Read target image
@@ -127,64 +166,79 @@ int main(int argc, char* argv[]) {
         cerr << "Error: Unable to compute histogram for the target image." << endl;
         return 1;
     }
-
-    // Read feature vectors for database images from the CSV file and compute distances
-    vector<pair<double, string>> distances;
-    csvFile.open(csvFilePath);
-    if (!csvFile.is_open()) {
-        cerr << "Error: Unable to open CSV file." << endl;
-        return 1;
+    double targetMillis = stopwatch.millis();
+
+    // Feature distances of every database image in one matrix-vector product
+    // against the unit-length target; normalized store rows need nothing more.
+    // With int8 codes the product runs over bytes, a quarter of the memory; with
+    // a PCA index the target is projected and only the reduced rows are read.
+    // The index is unwhitened, so half their squared distance stands in for the
+    // cosine distance and is weighed against the histogram distance as one.
+    vector<string> filenames;
+    for (size_t i = 0; i < count; ++i) {
+        filenames.emplace_back(useStore ? store.name(i) : csvRows.name(i));
+    }
+    vector<float> query(dimension), featureDistances(count);
+    normalizeVector(rows + target * dimension, query.data(), dimension);
+    if (usePca) {
+        vector<float> reducedQuery(pcaIndex.dimension);
+        projectPcaRow(pcaIndex, query.data(), reducedQuery.data());
+        pcaDistances(pcaIndex, 0, count, reducedQuery.data(), featureDistances.data());
+    } else if (useIndex) {
+        Int8Query int8Query;
+        quantizeInt8Query(int8Index, query.data(), int8Query);
+        const size_t blockRows = 1024;
+        parallelFor(pool, (count + blockRows - 1) / blockRows, [&](size_t block) {
+            vector<int32_t> products;
+            size_t first = block * blockRows;
+            int8CosineDistances(int8Index, int8Query, first, min(blockRows, count - first), products, featureDistances.data() + first);
+        }, 1);
+    } else {
+        cosineDistances(rows, count, dimension, query.data(), rowsNormalized, featureDistances.data());
     }
-    while (getline(csvFile, line)) {
-        istringstream iss(line);
-        vector<string> tokens;
-        string token;
-        while (getline(iss, token, ',')) {
-            tokens.push_back(token);
-        }
-        if (tokens.size() < 513) {
-            cerr << "Error: Invalid CSV format." << endl;
-            return 1;
-        }
-        string filename = tokens[0];
-        tokens.erase(tokens.begin());
-        vector<float> values;
-        for (const string& val : tokens) {
-            values.push_back(stof(val));
-        }
-        Mat featureVector = Mat(values, true).reshape(1, 1);
-
-        // Compute cosine distance between feature vectors
-        double featureDistance = computeCosineDistance(targetFeatureVector, featureVector);
 
-        // Read and compute histogram for the current image
-        Mat image = imread(databaseDir + "/" + filename);
-        if (image.empty()) {
-            cerr << "Error: Unable to read image " << filename << endl;
-            continue;
+    // Decode the database images and keep each worker's N closest combined distances;
+    // each kept match carries its feature and histogram distances for the headless output
+    int candidates = useIndex && rerank > 0 ? max(N, static_cast<int>(rerank)) : N;
+    vector<TopN<ScoredRow<2>>> partials = parallelScan(pool, filenames.size(), TopN<ScoredRow<2>>(candidates), [&](size_t i, TopN<ScoredRow<2>>& best) {
+        ScoredRow<2> match;
+        match.row = i;
+        double combinedDistance = 0.0;
+        if (computeCombinedDistance(featureDistances[i], targetHist, databaseDir, filenames[i], combinedDistance, match.components)) {
+            best.push(combinedDistance, match);
         }
-        Mat imageHist = computeRGChromaticityHistogram(image, 16);
-        if (imageHist.empty()) {
-            cerr << "Error: Unable to compute histogram for image " << filename << endl;
-            continue;
+    });
+
+    // Merge the per-thread results, closest first
+    vector<TopN<ScoredRow<2>>::Entry> distances = mergeTopN(partials).sorted();
+
+    // Re-rank the best candidates with their exact float feature distances
+    if (candidates > N) {
+        TopN<ScoredRow<2>> exact(N);
+        for (auto match : distances) {
+            array<double, 2>& parts = match.id.components;
+            const float* row = rows + match.id.row * dimension;
+            parts[0] = rowCosineDistance(row, query.data(), dimension, rowsNormalized);
+            exact.push((parts[0] + parts[1]) / 2.0, match.id);
         }
-
-        // Compute histogram intersection distance between target and current image
-        double histDistance = computeChiSquaredDistance(targetHist, imageHist);
-
-        // Combine distances using a weighted average or other strategies as needed
-        double combinedDistance = (featureDistance + histDistance) / 2.0;
-
-        distances.push_back(make_pair(combinedDistance, filename));
+        distances = exact.sorted();
     }
-    csvFile.close();
 
-    // Sort images based on combined distances
-    sort(distances.begin(), distances.end());
+    // Print machine-readable results when running headless
+    if (headless) {
+        double totalMillis = stopwatch.millis();
+        NamedValues timings = { { "target", targetMillis }, { "scan", totalMillis - targetMillis }, { "total", totalMillis } };
+        for (size_t i = 0; i < distances.size(); ++i) {
+            const array<double, 2>& parts = distances[i].id.components;
+            NamedValues componentDistances = { { "feature", parts[0] }, { "histogram", parts[1] } };
+            writeResultRecord(cout, targetImagePath, i + 1, filenames[distances[i].id.row], distances[i].distance, componentDistances, timings);
+        }
+        return 0;
+    }
 
     // Display the top N images
-    for (int i = 0; i < min(N, static_cast<int>(distances.size())); ++i) {
-        cout << "Distance: " << distances[i].first << ", Image: " << distances[i].second << endl;
+    for (const auto& match : distances) {
+        cout << "Distance: " << match.distance << ", Image: " << filenames[match.id.row] << endl;
     }
 
     return 0;
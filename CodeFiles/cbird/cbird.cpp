@@ -0,0 +1,447 @@
+/*
+
+Authored by: Aadhi Aadhavan Balasubramanian, Harishraj Udaya Bhaskar
+Date: 10/17/2026
+
+*/
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <opencv2/opencv.hpp>
+#include "chiSquared.h"
+#include "cliOptions.h"
+#include "colorHistograms.h"
+#include "featureIndex.h"
+#include "imageDecode.h"
+#include "parallelScan.h"
+#include "patchMatrix.h"
+#include "pipeline.h"
+#include "resultWriter.h"
+#include "textureHistogram.h"
+#include "topN.h"
+
+using namespace std;
+using namespace cv;
+
+// cbird keeps one feature index in memory and answers queries over a Unix
+// domain socket, so interactive tools pay for one target extraction and one
+// scan instead of a process start and an index load per query.
+//
+// Requests are single lines; a response is one JSON object per match (the
+// same records as --headless) followed by an empty line:
+//   QUERY <N> <image_path>            query with an image file the daemon can read
+//   QUERYBYTES <N> <length>\n<bytes>  query with raw encoded image bytes
+//   QUIT                              close the connection
+// Errors are answered with {"error":"..."} and an empty line.
+
+// Largest image accepted by QUERYBYTES
+const size_t kMaxQueryBytes = 256u << 20;
+
+// How one index kind extracts a target row and compares it with database rows.
+// These mirror the query binaries that write each kind. Float kinds set
+// extract and distance; byte kinds (valueBytes 1) set extractBytes and
+// byteDistance instead.
+struct FeatureKind {
+    string name;
+    uint32_t dimension;
+    uint32_t valueBytes = sizeof(float);
+    vector<string> componentNames;
+    function<bool(const Mat& image, float* row)> extract;
+    function<double(const float* target, const float* row, double* components)> distance;
+    function<bool(const Mat& image, uint8_t* row)> extractBytes;
+    function<double(const uint8_t* target, const uint8_t* row, double* components)> byteDistance;
+};
+
+// Function to copy a continuous float histogram into an index row
+bool copyHistogram(const Mat& hist, float* row) {
+    if (hist.empty()) {
+        return false;
+    }
+    copy(hist.ptr<float>(), hist.ptr<float>() + hist.total(), row);
+    return true;
+}
+
+// Function to look up the extractor and distance for an index kind
+bool findFeatureKind(const string& name, FeatureKind& kind) {
+    kind.name = name;
+    if (name == "center-patch-7x7") {
+        // Question1: 7x7 BGR patch at the center, sum of squared differences
+        kind.dimension = 7 * 7 * 3;
+        kind.valueBytes = 1;
+        kind.extractBytes = [](const Mat& image, uint8_t* row) {
+            if (image.cols < 7 || image.rows < 7) {
+                return false;
+            }
+            Mat patch = image(Rect((image.cols - 7) / 2, (image.rows - 7) / 2, 7, 7)).clone().reshape(1, 1);
+            copy(patch.ptr<uchar>(), patch.ptr<uchar>() + 7 * 7 * 3, row);
+            return true;
+        };
+        kind.byteDistance = [](const uint8_t* target, const uint8_t* row, double*) {
+            return static_cast<double>(patchSquaredDistance(target, row, 7 * 7 * 3));
+        };
+    } else if (name == "rg-chromaticity-16") {
+        // Question2: whole-image RG histogram, chi-squared
+        kind.dimension = 16 * 16;
+        kind.extract = [](const Mat& image, float* row) {
+            ColorHistogramSpec spec;
+            spec.rgBins = 16;
+            return copyHistogram(computeColorHistograms(image, spec).rg, row);
+        };
+        kind.distance = [](const float* target, const float* row, double*) {
+            return chiSquaredDistance(target, row, 16 * 16);
+        };
+    } else if (name == "rg-top-bottom-8") {
+        // Question3: top and bottom half RG histograms, equally weighted
+        kind.dimension = 8 * 8 * 2;
+        kind.componentNames = { "top", "bottom" };
+        kind.extract = [](const Mat& image, float* row) {
+            ColorHistogramSpec spec;
+            spec.halfBins = 8;
+            ColorHistograms hists = computeColorHistograms(image, spec);
+            return copyHistogram(hists.top, row) && copyHistogram(hists.bottom, row + 8 * 8);
+        };
+        kind.distance = [](const float* target, const float* row, double* components) {
+            components[0] = chiSquaredDistance(target, row, 8 * 8);
+            components[1] = chiSquaredDistance(target + 8 * 8, row + 8 * 8, 8 * 8);
+            return 0.5 * components[0] + 0.5 * components[1];
+        };
+    } else if (name == "color-texture-8" || name == "color-texture-8-magnitude") {
+        // Question4: 3D color histogram and gradient orientation histogram, equally weighted
+        bool magnitudeWeighted = name == "color-texture-8-magnitude";
+        kind.dimension = 8 * 8 * 8 + 8;
+        kind.componentNames = { "color", "texture" };
+        kind.extract = [magnitudeWeighted](const Mat& image, float* row) {
+            ColorHistogramSpec spec;
+            spec.colorBins = 8;
+            return copyHistogram(computeColorHistograms(image, spec).color, row) &&
+                   copyHistogram(computeOrientationHistogram(image, 8, magnitudeWeighted), row + 8 * 8 * 8);
+        };
+        kind.distance = [](const float* target, const float* row, double* components) {
+            components[0] = chiSquaredDistance(target, row, 8 * 8 * 8);
+            components[1] = chiSquaredDistance(target + 8 * 8 * 8, row + 8 * 8 * 8, 8);
+            return 0.5 * components[0] + 0.5 * components[1];
+        };
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Everything a query needs, shared by all connections
+struct QueryService {
+    FeatureIndex index;
+    FeatureKind kind;
+    DecodeOptions decode;
+    ThreadPool* pool;
+    mutex poolMutex;  // the pool runs one scan at a time
+};
+
+// Function to format an error response
+string errorResponse(const string& message) {
+    return "{\"error\":" + jsonString(message) + "}\n\n";
+}
+
+// Function to answer one query with the N closest index entries
+string answerQuery(QueryService& service, const vector<uchar>& bytes, const string& query, int N) {
+    Stopwatch stopwatch;
+    N = static_cast<int>(min<size_t>(static_cast<size_t>(N), service.index.size()));
+    Mat image = decodeImage(bytes, service.decode);
+    if (image.empty()) {
+        return errorResponse("unable to decode query image");
+    }
+    const FeatureKind& kind = service.kind;
+    const FeatureIndex& index = service.index;
+    bool byteRows = kind.valueBytes == 1;
+    vector<float> target(byteRows ? 0 : kind.dimension);
+    vector<uint8_t> byteTarget(byteRows ? kind.dimension : 0);
+    if (byteRows ? !kind.extractBytes(image, byteTarget.data()) : !kind.extract(image, target.data())) {
+        return errorResponse("unable to compute features for query image");
+    }
+    auto score = [&](size_t i, double* components) {
+        return byteRows ? kind.byteDistance(byteTarget.data(), index.byteRow(i), components) : kind.distance(target.data(), index.row(i), components);
+    };
+    double targetMillis = stopwatch.millis();
+
+    vector<TopN<size_t>> partials;
+    {
+        lock_guard<mutex> lock(service.poolMutex);
+        partials = parallelScan(*service.pool, service.index.size(), TopN<size_t>(N), [&](size_t i, TopN<size_t>& best) {
+            double components[2];
+            best.push(score(i, components), i);
+        }, 64);
+    }
+    vector<TopN<size_t>::Entry> matches = mergeTopN(partials).sorted();
+    double totalMillis = stopwatch.millis();
+
+    // Components are recomputed for the N matches only
+    NamedValues timings = { { "target", targetMillis }, { "scan", totalMillis - targetMillis }, { "total", totalMillis } };
+    ostringstream response;
+    for (size_t i = 0; i < matches.size(); ++i) {
+        double components[2];
+        score(matches[i].id, components);
+        NamedValues componentDistances;
+        for (size_t c = 0; c < service.kind.componentNames.size(); ++c) {
+            componentDistances.emplace_back(service.kind.componentNames[c], components[c]);
+        }
+        writeResultRecord(response, query, i + 1, service.index.paths[matches[i].id], matches[i].distance, componentDistances, timings);
+    }
+    response << "\n";
+    return response.str();
+}
+
+// Buffered reads of lines and fixed-size payloads from a connected socket
+class SocketReader {
+public:
+    explicit SocketReader(int fd) : fd_(fd) {}
+
+    bool readLine(string& line) {
+        line.clear();
+        while (true) {
+            size_t newline = buffer_.find('\n', position_);
+            if (newline != string::npos) {
+                line.assign(buffer_, position_, newline - position_);
+                position_ = newline + 1;
+                if (!line.empty() && line.back() == '\r') {
+                    line.pop_back();
+                }
+                return true;
+            }
+            if (!fill()) {
+                return false;
+            }
+        }
+    }
+
+    bool readExact(vector<uchar>& bytes, size_t length) {
+        bytes.clear();
+        bytes.reserve(length);
+        while (bytes.size() < length) {
+            if (position_ == buffer_.size() && !fill()) {
+                return false;
+            }
+            size_t take = min(length - bytes.size(), buffer_.size() - position_);
+            bytes.insert(bytes.end(), buffer_.begin() + position_, buffer_.begin() + position_ + take);
+            position_ += take;
+        }
+        return true;
+    }
+
+    // Function to read and discard length bytes, keeping the stream in step with the requests
+    bool skip(size_t length) {
+        while (length > 0) {
+            if (position_ == buffer_.size() && !fill()) {
+                return false;
+            }
+            size_t take = min(length, buffer_.size() - position_);
+            position_ += take;
+            length -= take;
+        }
+        return true;
+    }
+
+private:
+    bool fill() {
+        buffer_.erase(0, position_);
+        position_ = 0;
+        char chunk[65536];
+        ssize_t received = recv(fd_, chunk, sizeof(chunk), 0);
+        if (received <= 0) {
+            return false;
+        }
+        buffer_.append(chunk, static_cast<size_t>(received));
+        return true;
+    }
+
+    int fd_;
+    string buffer_;
+    size_t position_ = 0;
+};
+
+// Function to write a whole response, false once the client has gone away.
+// SIGPIPE is ignored process-wide (see main), so a closed peer is an error here.
+bool sendAll(int fd, const string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t written = send(fd, data.data() + sent, data.size() - sent, 0);
+        if (written <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// Function to serve requests on one connection until the client closes it.
+// A failing request is answered with an error.
+void serveRequests(int fd, QueryService& service) {
+    SocketReader reader(fd);
+    string line;
+    while (reader.readLine(line)) {
+        istringstream request(line);
+        string command;
+        request >> command;
+        if (command.empty()) {
+            continue;
+        }
+        if (command == "QUIT") {
+            break;
+        }
+
+        int N = 0;
+        request >> N;
+        string response;
+        try {
+            if (command == "QUERY") {
+                string path;
+                getline(request >> ws, path);
+                if (N <= 0 || path.empty()) {
+                    response = errorResponse("usage: QUERY <N> <image_path>");
+                } else if (!isRegularFile(path)) {
+                    response = errorResponse("not a regular file: " + path);
+                } else {
+                    response = answerQuery(service, readFileBytes(path), path, N);
+                }
+            } else if (command == "QUERYBYTES") {
+                size_t length = 0;
+                request >> length;
+                if (length > kMaxQueryBytes) {
+                    // Too large to drain; the stream cannot be resynchronized
+                    sendAll(fd, errorResponse("query image larger than " + to_string(kMaxQueryBytes) + " bytes"));
+                    break;
+                }
+                if (N <= 0 || length == 0) {
+                    // The payload still follows the line, so skip it before the next command
+                    if (!reader.skip(length)) {
+                        break;
+                    }
+                    response = errorResponse("usage: QUERYBYTES <N> <length>, then length bytes");
+                } else {
+                    vector<uchar> bytes;
+                    if (!reader.readExact(bytes, length)) {
+                        break;
+                    }
+                    response = answerQuery(service, bytes, "<bytes>", N);
+                }
+            } else {
+                response = errorResponse("unknown command " + command);
+            }
+        } catch (const exception& error) {
+            response = errorResponse(string("query failed: ") + error.what());
+        }
+        if (!sendAll(fd, response)) {
+            break;
+        }
+    }
+}
+
+// Function to run one connection's thread. Anything the request handlers
+// did not catch (such as running out of memory buffering a line) closes this
+// connection instead of terminating the daemon.
+void serveClient(int fd, QueryService& service) {
+    try {
+        serveRequests(fd, service);
+    } catch (const exception& error) {
+        cerr << "Error: Connection closed: " << error.what() << endl;
+    }
+    close(fd);
+}
+
+// Socket path removed again when the daemon is stopped
+static char socketPathToRemove[sizeof(sockaddr_un::sun_path)];
+
+void stopDaemon(int) {
+    unlink(socketPathToRemove);
+    _exit(0);
+}
+
+int main(int argc, char* argv[]) {
+    int threads = 0;
+    if (!takeThreadCount(argc, argv, threads)) {
+        return 1;
+    }
+    DecodeOptions decode;
+    if (!takeDecodeOptions(argc, argv, decode)) {
+        return 1;
+    }
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " [--threads N] [--reduce 2|4|8 | --max-side N] <index_file> <socket_path>" << endl;
+        return 1;
+    }
+    string indexPath = argv[1];
+    string socketPath = argv[2];
+
+    // Load the index once; its kind decides how queries are extracted and compared
+    setNumThreads(1);
+    ThreadPool pool(threads);
+    QueryService service;
+    service.pool = &pool;
+    if (!loadFeatureIndex(indexPath, "", 0, 0, service.index)) {
+        return 1;
+    }
+    string featureKind;
+    bool knownKind = parseDecodeKind(service.index.kind, featureKind, service.decode) && findFeatureKind(featureKind, service.kind);
+
+    // Patch indexes from before version 3 hold their bytes as floats
+    if (knownKind && service.kind.valueBytes == 1) {
+        convertFeatureIndexToBytes(service.index);
+    }
+    if (!knownKind || service.kind.dimension != service.index.dimension || service.kind.valueBytes != service.index.valueBytes) {
+        cerr << "Error: Unsupported index kind '" << service.index.kind << "'." << endl;
+        return 1;
+    }
+
+    // Query images are decoded the way the index rows were; explicit options must agree
+    bool decodeGiven = decode.reduction != 1 || decode.maxSide > 0;
+    if (decodeGiven && decodeKind(featureKind, decode) != service.index.kind) {
+        cerr << "Error: Index " << indexPath << " was built as '" << service.index.kind << "', not with the given --reduce/--max-side." << endl;
+        return 1;
+    }
+
+    // Listen on the Unix domain socket, replacing a stale one from an earlier run
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        cerr << "Error: Socket path is too long." << endl;
+        return 1;
+    }
+    strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    strncpy(socketPathToRemove, socketPath.c_str(), sizeof(socketPathToRemove) - 1);
+    unlink(socketPath.c_str());
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 64) != 0) {
+        cerr << "Error: Unable to listen on " << socketPath << ": " << strerror(errno) << endl;
+        return 1;
+    }
+    signal(SIGINT, stopDaemon);
+    signal(SIGTERM, stopDaemon);
+    signal(SIGPIPE, SIG_IGN);
+    cout << "Serving " << service.index.size() << " '" << service.index.kind << "' images on " << socketPath << endl;
+
+    // One thread per connection; scans share the pool
+    while (true) {
+        int client = accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            cerr << "Error: accept failed: " << strerror(errno) << endl;
+            break;
+        }
+        thread(serveClient, client, ref(service)).detach();
+    }
+    close(listener);
+    unlink(socketPath.c_str());
+    return 1;
+}
@@ -0,0 +1,72 @@
+/*
+
+Authored by: Aadhi Aadhavan Balasubramanian, Harishraj Udaya Bhaskar
+Date: 10/17/2026
+
+*/
+
+#ifndef APPROXIMATE_INDEX_H
+#define APPROXIMATE_INDEX_H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "binaryFile.h"
+#include "dotKernels.h"
+#include "topN.h"
+
+// Pieces shared by the approximate indexes over an embedding store. Every
+// index file starts with the same three fields, followed by its own layout:
+//   char[8]  magic naming the kind of index
+//   uint32   format version
+//   uint32   dimension of the store rows
+
+// Function to check whether a file starts with an index magic
+inline bool hasIndexMagic(const std::string& path, const char (&magic)[8]) {
+    std::ifstream in(path, std::ios::binary);
+    char found[8];
+    if (!in.read(found, sizeof(found))) {
+        return false;
+    }
+    return std::memcmp(found, magic, sizeof(found)) == 0;
+}
+
+// Function to write the magic, format version and store dimension of an index file
+inline void writeIndexHeader(std::ostream& out, const char (&magic)[8], uint32_t version, uint32_t dimension) {
+    out.write(magic, sizeof(magic));
+    out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    out.write(reinterpret_cast<const char*>(&dimension), sizeof(dimension));
+}
+
+// Function to read the header of an index file, false when it holds another
+// kind of index or another version; kind names the index in the message
+inline bool readIndexHeader(std::istream& in, const std::string& path, const std::string& kind, const char (&magic)[8],
+                            uint32_t version, uint32_t& dimension) {
+    char found[8];
+    uint32_t foundVersion = 0;
+    in.read(found, sizeof(found));
+    in.read(reinterpret_cast<char*>(&foundVersion), sizeof(foundVersion));
+    in.read(reinterpret_cast<char*>(&dimension), sizeof(dimension));
+    if (!in || std::memcmp(found, magic, sizeof(found)) != 0 || foundVersion != version) {
+        std::cerr << "Error: " << path << " is not a supported " << kind << " index." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Function to re-rank the candidates of an approximate scan by their exact
+// cosine distance to a unit-length query, keeping the N closest
+inline std::vector<TopN<size_t>::Entry> rerankExact(const float* rows, bool rowsNormalized, const float* unitQuery, size_t dimension,
+                                                    const std::vector<TopN<size_t>::Entry>& matches, int N) {
+    TopN<size_t> exact(N);
+    for (const TopN<size_t>::Entry& match : matches) {
+        exact.push(rowCosineDistance(rows + match.id * dimension, unitQuery, dimension, rowsNormalized), match.id);
+    }
+    return exact.sorted();
+}
+
+#endif // APPROXIMATE_INDEX_H
@@ -0,0 +1,28 @@
+/*
+
+Authored by: Aadhi Aadhavan Balasubramanian, Harishraj Udaya Bhaskar
+Date: 10/17/2026
+
+*/
+
+#ifndef BINARY_FILE_H
+#define BINARY_FILE_H
+
+#include <cstdint>
+#include <istream>
+
+// Function to count the bytes between the read position of a binary file and
+// its end, so a loader can reject counts the file is too short to hold before
+// allocating for them
+inline uint64_t bytesLeft(std::istream& in) {
+    std::streampos here = in.tellg();
+    if (!in || here < 0) {
+        return 0;
+    }
+    in.seekg(0, std::ios::end);
+    std::streampos end = in.tellg();
+    in.seekg(here);
+    return end > here ? static_cast<uint64_t>(end - here) : 0;
+}
+
+#endif // BINARY_FILE_H
@@ -0,0 +1,263 @@
+/*
+
+Authored by: Aadhi Aadhavan Balasubramanian, Harishraj Udaya Bhaskar
+Date: 10/17/2026
+
+*/
+
+#ifndef BINARY_INDEX_H
+#define BINARY_INDEX_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "dotKernels.h"
+#include "approximateIndex.h"
+#include "parallelScan.h"
+#include "topN.h"
+
+// Binary sign hashes of the rows of an embedding store, for a cheap first
+// pass. Every row is projected onto bitCount random hyperplanes, and only the
+// side of each one is kept, one bit per plane. The share of bits in which two
+// hashes differ estimates the angle between the rows: cos(pi * hamming / bits).
+// A scan is an XOR and a popcount per 64-bit word, with no float
+// multiplies. The best candidates can be re-ranked exactly against the store
+// rows.
+//
+// File layout (native byte order):
+//   char[8]  magic "CBIRBIN1"
+//   uint32   format version
+//   uint32   dimension
+//   uint32   bit count (a multiple of 64)
+//   uint64   row count of the store
+//   uint64   fingerprint of the store (embeddingStoreFingerprint)
+//   float    planes[bitCount][dimension]
+//   uint64   codes[rowCount][bitCount / 64]
+struct BinaryIndex {
+    uint32_t dimension = 0;
+    uint32_t bitCount = 0;
+    uint64_t rowCount = 0;
+    uint64_t storeFingerprint = 0;
+    std::vector<float> planes;
+    std::vector<uint64_t> codes;
+
+    size_t words() const { return bitCount / 64; }
+    const uint64_t* code(size_t row) const { return codes.data() + row * words(); }
+};
+
+static const char kBinaryIndexMagic[8] = { 'C', 'B', 'I', 'R', 'B', 'I', 'N', '1' };
+static const uint32_t kBinaryIndexVersion = 2;
+
+namespace binary_index_detail {
+
+// Rows hashed per matrix product, and rows scanned per task
+const size_t kHashBlockRows = 256;
+const size_t kScanBlockRows = 4096;
+
+inline void genericHamming(const uint64_t* codes, size_t rows, size_t words, const uint64_t* query, uint32_t* out) {
+    for (size_t r = 0; r < rows; ++r) {
+        const uint64_t* code = codes + r * words;
+        uint32_t distance = 0;
+        for (size_t w = 0; w < words; ++w) {
+            distance += static_cast<uint32_t>(__builtin_popcountll(code[w] ^ query[w]));
+        }
+        out[r] = distance;
+    }
+}
+
+#ifdef CBIR_X86_KERNELS
+
+// Same loop, but compiled to the popcnt instruction instead of a library call
+__attribute__((target("popcnt"))) inline void popcntHamming(const uint64_t* codes, size_t rows, size_t words, const uint64_t* query, uint32_t* out) {
+    for (size_t r = 0; r < rows; ++r) {
+        const uint64_t* code = codes + r * words;
+        uint64_t distance = 0;
+        for (size_t w = 0; w < words; ++w) {
+            distance += static_cast<uint64_t>(__builtin_popcountll(code[w] ^ query[w]));
+        }
+        out[r] = static_cast<uint32_t>(distance);
+    }
+}
+
+// Eight words per vpopcntq, so a 512-bit hash is one XOR and one popcount
+__attribute__((target("avx512f,avx512vpopcntdq"))) inline void avx512Hamming(const uint64_t* codes, size_t rows, size_t words, const uint64_t* query, uint32_t* out) {
+    for (size_t r = 0; r < rows; ++r) {
+        const uint64_t* code = codes + r * words;
+        __m512i acc = _mm512_setzero_si512();
+        for (size_t w = 0; w < words; w += 8) {
+            size_t remaining = words - w;
+            __mmask8 lanes = remaining >= 8 ? static_cast<__mmask8>(0xFF) : static_cast<__mmask8>((1u << remaining) - 1);
+            __m512i difference = _mm512_xor_si512(_mm512_maskz_loadu_epi64(lanes, code + w), _mm512_maskz_loadu_epi64(lanes, query + w));
+            acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(difference));
+        }
+        out[r] = static_cast<uint32_t>(_mm512_reduce_add_epi64(acc));
+    }
+}
+
+#endif // CBIR_X86_KERNELS
+
+typedef void (*HammingKernel)(const uint64_t*, size_t, size_t, const uint64_t*, uint32_t*);
+
+// Function to pick the fastest popcount path the running CPU supports
+inline HammingKernel selectHammingKernel() {
+#ifdef CBIR_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512vpopcntdq")) {
+        return avx512Hamming;
+    }
+    if (__builtin_cpu_supports("popcnt")) {
+        return popcntHamming;
+    }
+#endif
+    return genericHamming;
+}
+
+// Function to hash count rows: bit b of a row is set when it lies on the positive side of plane b
+inline void hashRows(const BinaryIndex& index, const float* rows, size_t count, uint64_t* codes) {
+    size_t bits = index.bitCount, words = index.words();
+    std::vector<float> projections(count * bits);
+    matrixProductTransposed(rows, count, index.planes.data(), bits, index.dimension, projections.data());
+    for (size_t r = 0; r < count; ++r) {
+        uint64_t* code = codes + r * words;
+        std::fill(code, code + words, 0);
+        for (size_t b = 0; b < bits; ++b) {
+            if (projections[r * bits + b] > 0.0f) {
+                code[b / 64] |= uint64_t(1) << (b % 64);
+            }
+        }
+    }
+}
+
+} // namespace binary_index_detail
+
+// Function to compute the Hamming distances of count hashes to a query hash
+inline void hammingDistances(const uint64_t* codes, size_t count, size_t words, const uint64_t* query, uint32_t* out) {
+    static const binary_index_detail::HammingKernel kernel = binary_index_detail::selectHammingKernel();
+    kernel(codes, count, words, query, out);
+}
+
+// Function to hash every row with bitCount random hyperplanes, rounded up to
+// whole 64-bit words. The sign of a projection does not depend on the row's
+// length, so rows need not be unit length.
+inline void buildBinaryIndex(const float* rows, size_t count, size_t dimension, size_t bitCount, ThreadPool& pool, BinaryIndex& index) {
+    using namespace binary_index_detail;
+    bitCount = std::max<size_t>(64, (bitCount + 63) / 64 * 64);
+    index.dimension = static_cast<uint32_t>(dimension);
+    index.bitCount = static_cast<uint32_t>(bitCount);
+    index.rowCount = count;
+
+    // Gaussian planes are spread evenly over all directions
+    std::mt19937 random(12345);
+    std::normal_distribution<float> gaussian(0.0f, 1.0f);
+    index.planes.resize(bitCount * dimension);
+    for (float& value : index.planes) {
+        value = gaussian(random);
+    }
+
+    index.codes.assign(count * index.words(), 0);
+    size_t blocks = (count + kHashBlockRows - 1) / kHashBlockRows;
+    parallelFor(pool, blocks, [&](size_t block) {
+        size_t first = block * kHashBlockRows;
+        hashRows(index, rows + first * dimension, std::min(kHashBlockRows, count - first), index.codes.data() + first * index.words());
+    }, 1);
+}
+
+// Function to rank every row by the Hamming distance of its hash to the
+// query's, closest first. Without rerank the distances are the angles the
+// hashes estimate, as 1 - cos(angle). When rerank is larger than zero, the
+// best max(rerank, N) rows are scored again exactly against the store rows;
+// rowsNormalized tells whether those have unit length.
+inline std::vector<TopN<size_t>::Entry> searchBinaryIndex(const BinaryIndex& index, const float* rows, bool rowsNormalized,
+                                                          const float* unitQuery, int N, size_t rerank, ThreadPool& pool) {
+    using namespace binary_index_detail;
+    std::vector<uint64_t> query(index.words());
+    hashRows(index, unitQuery, 1, query.data());
+    int candidates = rerank > 0 ? std::max(N, static_cast<int>(rerank)) : N;
+
+    size_t blocks = (index.rowCount + kScanBlockRows - 1) / kScanBlockRows;
+    std::vector<TopN<size_t>> partials = parallelScan(pool, blocks, TopN<size_t>(candidates), [&](size_t block, TopN<size_t>& best) {
+        thread_local std::vector<uint32_t> distances;
+        size_t first = block * kScanBlockRows;
+        size_t blockRows = std::min<size_t>(kScanBlockRows, index.rowCount - first);
+        distances.resize(blockRows);
+        hammingDistances(index.code(first), blockRows, index.words(), query.data(), distances.data());
+        for (size_t r = 0; r < blockRows; ++r) {
+            best.push(distances[r], first + r);
+        }
+    }, 1);
+    std::vector<TopN<size_t>::Entry> matches = mergeTopN(partials).sorted();
+
+    if (rerank == 0) {
+        const double pi = 3.14159265358979323846;
+        for (TopN<size_t>::Entry& match : matches) {
+            match.distance = 1.0 - std::cos(pi * match.distance / index.bitCount);
+        }
+        return matches;
+    }
+    return rerankExact(rows, rowsNormalized, unitQuery, index.dimension, matches, N);
+}
+
+// Function to check whether a file starts with the binary index magic
+inline bool isBinaryIndexFile(const std::string& path) {
+    return hasIndexMagic(path, kBinaryIndexMagic);
+}
+
+// Function to write binary hashes to disk
+inline bool saveBinaryIndex(const BinaryIndex& index, const std::string& path) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Error: Unable to open binary index " << path << " for writing." << std::endl;
+        return false;
+    }
+    writeIndexHeader(out, kBinaryIndexMagic, kBinaryIndexVersion, index.dimension);
+    out.write(reinterpret_cast<const char*>(&index.bitCount), sizeof(index.bitCount));
+    out.write(reinterpret_cast<const char*>(&index.rowCount), sizeof(index.rowCount));
+    out.write(reinterpret_cast<const char*>(&index.storeFingerprint), sizeof(index.storeFingerprint));
+    out.write(reinterpret_cast<const char*>(index.planes.data()), index.planes.size() * sizeof(float));
+    out.write(reinterpret_cast<const char*>(index.codes.data()), index.codes.size() * sizeof(uint64_t));
+    out.close();
+    if (!out) {
+        std::cerr << "Error: Failed while writing binary index " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Function to read binary hashes from disk
+inline bool loadBinaryIndex(const std::string& path, BinaryIndex& index) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "Error: Unable to open binary index " << path << std::endl;
+        return false;
+    }
+    if (!readIndexHeader(in, path, "binary", kBinaryIndexMagic, kBinaryIndexVersion, index.dimension)) {
+        return false;
+    }
+    in.read(reinterpret_cast<char*>(&index.bitCount), sizeof(index.bitCount));
+    in.read(reinterpret_cast<char*>(&index.rowCount), sizeof(index.rowCount));
+    in.read(reinterpret_cast<char*>(&index.storeFingerprint), sizeof(index.storeFingerprint));
+    uint64_t left = bytesLeft(in);
+    if (!in || index.dimension == 0 || index.bitCount == 0 || index.bitCount % 64 != 0 ||
+        index.dimension > left / (index.bitCount * sizeof(float)) || index.rowCount > left / (index.bitCount / 8)) {
+        std::cerr << "Error: Binary index " << path << " has an invalid header." << std::endl;
+        return false;
+    }
+    index.planes.resize(static_cast<size_t>(index.bitCount) * index.dimension);
+    index.codes.resize(index.rowCount * index.words());
+    in.read(reinterpret_cast<char*>(index.planes.data()), index.planes.size() * sizeof(float));
+    in.read(reinterpret_cast<char*>(index.codes.data()), index.codes.size() * sizeof(uint64_t));
+    if (!in) {
+        std::cerr << "Error: Binary index " << path << " is truncated." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+#endif // BINARY_INDEX_H
@@ -0,0 +1,140 @@
+/*
+
+Authored by: Aadhi Aadhavan Balasubramanian, Harishraj Udaya Bhaskar
+Date: 10/17/2026
+
+*/
+
+#ifndef CHI_SQUARED_H
+#define CHI_SQUARED_H
+
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CBIR_X86_KERNELS 1
+#endif
+
+// Chi-squared distance between two float histograms of n bins:
+//   sum over bins of (a - b)^2 / (a + b), skipping bins where a + b == 0.
+// The vector paths divide every lane and mask out the empty bins afterwards,
+// so the inner loop has no branches. The widest path the CPU supports is
+// picked once at startup.
+namespace chi_squared_detail {
+
+inline double scalarKernel(const float* a, const float* b, size_t n) {
+    double distance = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        float sum = a[i] + b[i];
+        if (sum != 0.0f) {
+            float diff = a[i] - b[i];
+            distance += diff * diff / sum;
+        }
+    }
+    return distance;
+}
+
+#ifdef CBIR_X86_KERNELS
+
+__attribute__((target("sse2"))) inline double sseKernel(const float* a, const float* b, size_t n) {
+    const __m128 zero = _mm_setzero_ps();
+    __m128 acc0 = zero;
+    __m128 acc1 = zero;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128 a0 = _mm_loadu_ps(a + i), b0 = _mm_loadu_ps(b + i);
+        __m128 a1 = _mm_loadu_ps(a + i + 4), b1 = _mm_loadu_ps(b + i + 4);
+        __m128 s0 = _mm_add_ps(a0, b0), d0 = _mm_sub_ps(a0, b0);
+        __m128 s1 = _mm_add_ps(a1, b1), d1 = _mm_sub_ps(a1, b1);
+        __m128 q0 = _mm_div_ps(_mm_mul_ps(d0, d0), s0);
+        __m128 q1 = _mm_div_ps(_mm_mul_ps(d1, d1), s1);
+        acc0 = _mm_add_ps(acc0, _mm_and_ps(_mm_cmpneq_ps(s0, zero), q0));
+        acc1 = _mm_add_ps(acc1, _mm_and_ps(_mm_cmpneq_ps(s1, zero), q1));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+    double distance = static_cast<double>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+    return distance + scalarKernel(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2"))) inline double avx2Kernel(const float* a, const float* b, size_t n) {
+    const __m256 zero = _mm256_setzero_ps();
+    __m256 acc0 = zero;
+    __m256 acc1 = zero;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 a0 = _mm256_loadu_ps(a + i), b0 = _mm256_loadu_ps(b + i);
+        __m256 a1 = _mm256_loadu_ps(a + i + 8), b1 = _mm256_loadu_ps(b + i + 8);
+        __m256 s0 = _mm256_add_ps(a0, b0), d0 = _mm256_sub_ps(a0, b0);
+        __m256 s1 = _mm256_add_ps(a1, b1), d1 = _mm256_sub_ps(a1, b1);
+        __m256 q0 = _mm256_div_ps(_mm256_mul_ps(d0, d0), s0);
+        __m256 q1 = _mm256_div_ps(_mm256_mul_ps(d1, d1), s1);
+        acc0 = _mm256_add_ps(acc0, _mm256_and_ps(_mm256_cmp_ps(s0, zero, _CMP_NEQ_OQ), q0));
+        acc1 = _mm256_add_ps(acc1, _mm256_and_ps(_mm256_cmp_ps(s1, zero, _CMP_NEQ_OQ), q1));
+    }
+    __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    float lanes[4];
+    _mm_storeu_ps(lanes, half);
+    double distance = static_cast<double>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+    return distance + scalarKernel(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx512f"))) inline __m512 avx512Terms(__m512 va, __m512 vb) {
+    __m512 sum = _mm512_add_ps(va, vb);
+    __m512 diff = _mm512_sub_ps(va, vb);
+    __mmask16 nonEmpty = _mm512_cmp_ps_mask(sum, _mm512_setzero_ps(), _CMP_NEQ_OQ);
+    return _mm512_maskz_div_ps(nonEmpty, _mm512_mul_ps(diff, diff), sum);
+}
+
+__attribute__((target("avx512f"))) inline double avx512Kernel(const float* a, const float* b, size_t n) {
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm512_add_ps(acc0, avx512Terms(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i)));
+        acc1 = _mm512_add_ps(acc1, avx512Terms(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16)));
+    }
+    // The tail is handled with masked loads instead of a scalar loop
+    for (; i < n; i += 16) {
+        __mmask16 lanes = n - i >= 16 ? static_cast<__mmask16>(0xFFFF) : static_cast<__mmask16>((1u << (n - i)) - 1);
+        acc0 = _mm512_add_ps(acc0, avx512Terms(_mm512_maskz_loadu_ps(lanes, a + i), _mm512_maskz_loadu_ps(lanes, b + i)));
+    }
+    float lanes[16];
+    _mm512_storeu_ps(lanes, _mm512_add_ps(acc0, acc1));
+    double distance = 0.0;
+    for (float lane : lanes) {
+        distance += lane;
+    }
+    return distance;
+}
+
+#endif // CBIR_X86_KERNELS
+
+typedef double (*Kernel)(const float*, const float*, size_t);
+
+// Function to pick the widest kernel the running CPU supports
+inline Kernel selectKernel() {
+#ifdef CBIR_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return avx512Kernel;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return avx2Kernel;
+    }
+    return sseKernel;
+#else
+    return scalarKernel;
+#endif
+}
+
+} // namespace chi_squared_detail
+
+// Function to compute the chi-squared distance between two contiguous float histograms
+inline double chiSquaredDistance(const float* hist1, const float* hist2, size_t bins) {
+    static const chi_squared_detail::Kernel kernel = chi_squared_detail::selectKernel();
+    return kernel(hist1, hist2, bins);
+}
+
+#endif // CHI_SQUARED_H
@@ -0,0 +1,99 @@
+/*
+
+Authored by: Aadhi Aadhavan Balasubramanian, Harishraj Udaya Bhaskar
+Date: 10/17/2026
+
+*/
+
+#ifndef CLI_OPTIONS_H
+#define CLI_OPTIONS_H
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+// Optional "--name value" and "--name" switches are pulled out of argv before the
+// positional arguments are read, so every binary keeps its original usage.
+
+// Function to remove argv[index] and the following count entries
+inline void removeArguments(int& argc, char** argv, int index, int count) {
+    for (int i = index; i + count < argc; ++i) {
+        argv[i] = argv[i + count];
+    }
+    argc -= count;
+}
+
+// Function to take "--name value" out of argv, returning the value or the fallback
+inline std::string takeOption(int& argc, char** argv, const std::string& name, const std::string& fallback) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (name == argv[i]) {
+            std::string value = argv[i + 1];
+            removeArguments(argc, argv, i, 2);
+            return value;
+        }
+    }
+    return fallback;
+}
+
+// Function to take a bare "--name" switch out of argv, returning whether it was present
+inline bool takeFlag(int& argc, char** argv, const std::string& name) {
+    for (int i = 1; i < argc; ++i) {
+        if (name == argv[i]) {
+            removeArguments(argc, argv, i, 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Function to parse a whole string as a non-negative decimal integer
+inline bool parseCount(const std::string& text, size_t& value) {
+    if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0]))) {
+        return false;
+    }
+    errno = 0;
+    char* end = nullptr;
+    unsigned long long parsed = std::strtoull(text.c_str(), &end, 10);
+    if (errno == ERANGE || *end != '\0') {
+        return false;
+    }
+    value = static_cast<size_t>(parsed);
+    return true;
+}
+
+// Function to take "--name N" out of argv as a non-negative integer, keeping
+// the fallback when the switch is absent. Prints an error and returns false
+// when the value is not a number.
+inline bool takeCountOption(int& argc, char** argv, const std::string& name, size_t fallback, size_t& value) {
+    std::string text = takeOption(argc, argv, name, "");
+    if (text.empty()) {
+        value = fallback;
+        return true;
+    }
+    if (!parseCount(text, value)) {
+        std::cerr << "Error: " << name << " expects a non-negative integer, got '" << text << "'." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Function to take "--threads N" out of argv, defaulting to every hardware thread
+inline bool takeThreadCount(int& argc, char** argv, int& threads) {
+    size_t requested = 0;
+    if (!takeCountOption(argc, argv, "--threads", 0, requested)) {
+        return false;
+    }
+    threads = static_cast<int>(std::min<size_t>(requested, INT_MAX));
+    if (threads <= 0) {
+        threads = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    threads = threads > 0 ? threads : 1;
+    return true;
+}
+
+#endif // CLI_OPTIONS_H
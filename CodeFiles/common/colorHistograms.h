@@ -0,0 +1,217 @@
+/*
+
+Authored by: Aadhi Aadhavan Balasubramanian, Harishraj Udaya Bhaskar
+Date: 10/17/2026
+
+*/
+
+#ifndef COLOR_HISTOGRAMS_H
+#define COLOR_HISTOGRAMS_H
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "chiSquared.h"
+
+// Which histograms computeColorHistograms fills; a bin count of 0 skips that
+// histogram. All of them use uniform bins over [0, 256) per channel, the same
+// binning calcHist applies to the float images the query binaries used to build.
+struct ColorHistogramSpec {
+    int rgBins = 0;     // 2D histogram of channels 0 and 1 over the whole image
+    int halfBins = 0;   // 2D histogram of channels 0 and 1 over the top and bottom halves
+    int colorBins = 0;  // 3D histogram of channels 0, 1 and 2
+};
+
+// Normalized histograms, shaped like calcHist output (2D: bins x bins, 3D: bins^3)
+struct ColorHistograms {
+    cv::Mat rg;
+    cv::Mat top;
+    cv::Mat bottom;
+    cv::Mat color;
+};
+
+namespace color_histogram_detail {
+
+// Consecutive pixels go to different copies of each histogram, so runs of
+// same-colored pixels do not serialize on incrementing one counter
+const int kCopies = 4;
+
+// Per-channel bin lookups, pre-multiplied by each channel's stride in the histogram
+struct BinTable {
+    uint16_t first[256];
+    uint16_t second[256];
+    uint16_t third[256];
+
+    void build(int bins) {
+        for (int value = 0; value < 256; ++value) {
+            int bin = value * bins / 256;
+            first[value] = static_cast<uint16_t>(bin * bins * bins);
+            second[value] = static_cast<uint16_t>(bin * bins);
+            third[value] = static_cast<uint16_t>(bin);
+        }
+    }
+};
+
+struct Counters {
+    const BinTable* rg = nullptr;
+    const BinTable* half = nullptr;
+    const BinTable* color = nullptr;
+    uint32_t* rgCounts = nullptr;
+    uint32_t* halfCounts = nullptr;  // the top or bottom counts for the current row
+    uint32_t* colorCounts = nullptr;
+    size_t rgSize = 0;
+    size_t halfSize = 0;
+    size_t colorSize = 0;
+};
+
+// Function to count one pixel into copy `copy` of every enabled histogram
+template <bool RG, bool HALF, bool COLOR>
+inline void countPixel(const Counters& c, const uchar* pixel, size_t copy) {
+    uchar b = pixel[0], g = pixel[1];
+    if (RG) {
+        ++c.rgCounts[copy * c.rgSize + c.rg->second[b] + c.rg->third[g]];
+    }
+    if (HALF) {
+        ++c.halfCounts[copy * c.halfSize + c.half->second[b] + c.half->third[g]];
+    }
+    if (COLOR) {
+        ++c.colorCounts[copy * c.colorSize + c.color->first[b] + c.color->second[g] + c.color->third[pixel[2]]];
+    }
+}
+
+// Function to count one row of 8-bit BGR pixels
+template <bool RG, bool HALF, bool COLOR>
+void countRow(const Counters& c, const uchar* row, int cols) {
+    int x = 0;
+    for (; x + kCopies <= cols; x += kCopies, row += 3 * kCopies) {
+        countPixel<RG, HALF, COLOR>(c, row, 0);
+        countPixel<RG, HALF, COLOR>(c, row + 3, 1);
+        countPixel<RG, HALF, COLOR>(c, row + 6, 2);
+        countPixel<RG, HALF, COLOR>(c, row + 9, 3);
+    }
+    for (; x < cols; ++x, row += 3) {
+        countPixel<RG, HALF, COLOR>(c, row, 0);
+    }
+}
+
+typedef void (*RowKernel)(const Counters&, const uchar*, int);
+
+// Function to pick the row kernel that fills exactly the enabled histograms
+inline RowKernel selectRowKernel(bool rg, bool half, bool color) {
+    static const RowKernel kernels[8] = {
+        countRow<false, false, false>, countRow<false, false, true>,
+        countRow<false, true, false>,  countRow<false, true, true>,
+        countRow<true, false, false>,  countRow<true, false, true>,
+        countRow<true, true, false>,   countRow<true, true, true>,
+    };
+    return kernels[(rg ? 4 : 0) + (half ? 2 : 0) + (color ? 1 : 0)];
+}
+
+// Function to sum the copies of a histogram and scale it to [0, 1] the way
+// normalize(NORM_MINMAX) does: a flat histogram becomes all zeros
+inline void normalizeCounts(const uint32_t* counts, size_t size, float* out) {
+    std::vector<uint32_t> total(counts, counts + size);
+    for (int copy = 1; copy < kCopies; ++copy) {
+        for (size_t i = 0; i < size; ++i) {
+            total[i] += counts[copy * size + i];
+        }
+    }
+    std::pair<std::vector<uint32_t>::iterator, std::vector<uint32_t>::iterator> range =
+        std::minmax_element(total.begin(), total.end());
+    double smin = static_cast<float>(*range.first);
+    double smax = static_cast<float>(*range.second);
+    double scale = smax - smin > DBL_EPSILON ? 1.0 / (smax - smin) : 0.0;
+    float a = static_cast<float>(scale);
+    float b = static_cast<float>(-smin * scale);
+    for (size_t i = 0; i < size; ++i) {
+        out[i] = static_cast<float>(total[i]) * a + b;
+    }
+}
+
+} // namespace color_histogram_detail
+
+// Function to compute every requested color histogram of an 8-bit BGR image in
+// one pass over its pixels. The top half is rows [0, rows / 2) and the bottom
+// half the next rows / 2 rows, matching the Rect split Question3 used. Returns
+// empty histograms for an image that is not CV_8UC3.
+inline ColorHistograms computeColorHistograms(const cv::Mat& image, const ColorHistogramSpec& spec) {
+    using namespace color_histogram_detail;
+    ColorHistograms result;
+    if (image.empty() || image.type() != CV_8UC3) {
+        return result;
+    }
+
+    BinTable rgTable, halfTable, colorTable;
+    Counters counters;
+    std::vector<uint32_t> rgCounts, topCounts, bottomCounts, colorCounts;
+    if (spec.rgBins > 0) {
+        rgTable.build(spec.rgBins);
+        counters.rg = &rgTable;
+        counters.rgSize = static_cast<size_t>(spec.rgBins) * spec.rgBins;
+        rgCounts.assign(kCopies * counters.rgSize, 0);
+        counters.rgCounts = rgCounts.data();
+    }
+    if (spec.halfBins > 0) {
+        halfTable.build(spec.halfBins);
+        counters.half = &halfTable;
+        counters.halfSize = static_cast<size_t>(spec.halfBins) * spec.halfBins;
+        topCounts.assign(kCopies * counters.halfSize, 0);
+        bottomCounts.assign(kCopies * counters.halfSize, 0);
+    }
+    if (spec.colorBins > 0) {
+        colorTable.build(spec.colorBins);
+        counters.color = &colorTable;
+        counters.colorSize = static_cast<size_t>(spec.colorBins) * spec.colorBins * spec.colorBins;
+        colorCounts.assign(kCopies * counters.colorSize, 0);
+        counters.colorCounts = colorCounts.data();
+    }
+
+    // With an odd row count the last row belongs to neither half
+    bool rg = spec.rgBins > 0, half = spec.halfBins > 0, color = spec.colorBins > 0;
+    RowKernel rowKernel = selectRowKernel(rg, half, color);
+    RowKernel outsideHalvesKernel = selectRowKernel(rg, false, color);
+    int halfRows = image.rows / 2;
+    for (int y = 0; y < image.rows; ++y) {
+        if (y >= 2 * halfRows) {
+            outsideHalvesKernel(counters, image.ptr<uchar>(y), image.cols);
+            continue;
+        }
+        counters.halfCounts = y < halfRows ? topCounts.data() : bottomCounts.data();
+        rowKernel(counters, image.ptr<uchar>(y), image.cols);
+    }
+
+    if (rg) {
+        result.rg = cv::Mat(spec.rgBins, spec.rgBins, CV_32F);
+        normalizeCounts(rgCounts.data(), counters.rgSize, result.rg.ptr<float>());
+    }
+    if (half) {
+        result.top = cv::Mat(spec.halfBins, spec.halfBins, CV_32F);
+        result.bottom = cv::Mat(spec.halfBins, spec.halfBins, CV_32F);
+        normalizeCounts(topCounts.data(), counters.halfSize, result.top.ptr<float>());
+        normalizeCounts(bottomCounts.data(), counters.halfSize, result.bottom.ptr<float>());
+    }
+    if (color) {
+        int sizes[] = { spec.colorBins, spec.colorBins, spec.colorBins };
+        result.color = cv::Mat(3, sizes, CV_32F);
+        normalizeCounts(colorCounts.data(), counters.colorSize, result.color.ptr<float>());
+    }
+    return result;
+}
+
+// Function to compute the chi-squared distance between two histogram Mats
+// with the same number of bins. The float kernel reads each one as a single
+// contiguous CV_32F array. Histograms from this header and from
+// computeOrientationHistogram, and index rows, already have that layout.
+// Any other Mat, such as a ROI or another depth, is copied into it first.
+inline double chiSquaredDistance(const cv::Mat& hist1, const cv::Mat& hist2) {
+    assert(hist1.total() * hist1.channels() == hist2.total() * hist2.channels());
+    cv::Mat copy1, copy2;
+    const cv::Mat& a = hist1.isContinuous() && hist1.depth() == CV_32F ? hist1 : (hist1.convertTo(copy1, CV_32F), copy1);
+    const cv::Mat& b = hist2.isContinuous() && hist2.depth() == CV_32F ? hist2 : (hist2.convertTo(copy2, CV_32F), copy2);
+    return chiSquaredDistance(a.ptr<float>(), b.ptr<float>(), a.total() * a.channels());
+}
+
+#endif // COLOR_HISTOGRAMS_H
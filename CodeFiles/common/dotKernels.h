@@ -0,0 +1,654 @@
+/*
+
+Authored by: Aadhi Aadhavan Balasubramanian, Harishraj Udaya Bhaskar
+Date: 10/17/2026
+
+*/
+
+#ifndef DOT_KERNELS_H
+#define DOT_KERNELS_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CBIR_X86_KERNELS 1
+#endif
+
+// Dot products for embedding scans. Stores hold unit-length rows, so a cosine
+// distance is 1 - dot(query, row) and a scan is one matrix-vector product
+// over the mapped rows. The matrix kernels work on four rows at a time so
+// every load of the query feeds four FMAs. The common embedding sizes (128,
+// 256, 512, 768, 2048) get kernels with the dimension fixed at compile time,
+// so their loops have no tail or masks. Quantized scans use the byte
+// kernels: unsigned 8-bit rows against a signed 8-bit query, summed in 32-bit
+// integers. The widest path the CPU supports is picked once at startup.
+namespace dot_kernels_detail {
+
+inline float scalarDot(const float* a, const float* b, size_t n) {
+    float acc0 = 0.0f, acc1 = 0.0f, acc2 = 0.0f, acc3 = 0.0f;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc0 += a[i] * b[i];
+        acc1 += a[i + 1] * b[i + 1];
+        acc2 += a[i + 2] * b[i + 2];
+        acc3 += a[i + 3] * b[i + 3];
+    }
+    for (; i < n; ++i) {
+        acc0 += a[i] * b[i];
+    }
+    return (acc0 + acc1) + (acc2 + acc3);
+}
+
+inline void scalarGemv(const float* matrix, size_t rows, size_t dimension, const float* vector, float* out) {
+    for (size_t r = 0; r < rows; ++r) {
+        out[r] = scalarDot(matrix + r * dimension, vector, dimension);
+    }
+}
+
+inline void scalarGemm(const float* a, size_t aRows, const float* b, size_t bRows, size_t dimension, float* out) {
+    for (size_t i = 0; i < aRows; ++i) {
+        scalarGemv(b, bRows, dimension, a + i * dimension, out + i * bRows);
+    }
+}
+
+inline int32_t scalarByteDot(const uint8_t* a, const int8_t* b, size_t n) {
+    int32_t acc = 0;
+    for (size_t i = 0; i < n; ++i) {
+        acc += static_cast<int32_t>(a[i]) * b[i];
+    }
+    return acc;
+}
+
+inline void scalarByteGemv(const uint8_t* matrix, size_t rows, size_t dimension, const int8_t* vector, int32_t* out) {
+    for (size_t r = 0; r < rows; ++r) {
+        out[r] = scalarByteDot(matrix + r * dimension, vector, dimension);
+    }
+}
+
+#ifdef CBIR_X86_KERNELS
+
+__attribute__((target("avx2,fma"))) inline float avx2Sum(__m256 acc) {
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_movehdup_ps(half));
+    return _mm_cvtss_f32(half);
+}
+
+__attribute__((target("avx2,fma"))) inline float avx2Dot(const float* a, const float* b, size_t n) {
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+        acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(b + i + 16), acc2);
+        acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 24), _mm256_loadu_ps(b + i + 24), acc3);
+    }
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    }
+    float dot = avx2Sum(_mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3)));
+    return dot + scalarDot(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2,fma"))) inline void avx2Gemv(const float* matrix, size_t rows, size_t dimension, const float* vector, float* out) {
+    size_t r = 0;
+    for (; r + 4 <= rows; r += 4) {
+        const float* row0 = matrix + r * dimension;
+        const float* row1 = row0 + dimension;
+        const float* row2 = row1 + dimension;
+        const float* row3 = row2 + dimension;
+        __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+        __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 8 <= dimension; i += 8) {
+            __m256 v = _mm256_loadu_ps(vector + i);
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(row0 + i), v, acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(row1 + i), v, acc1);
+            acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(row2 + i), v, acc2);
+            acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(row3 + i), v, acc3);
+        }
+        size_t tail = dimension - i;
+        out[r] = avx2Sum(acc0) + scalarDot(row0 + i, vector + i, tail);
+        out[r + 1] = avx2Sum(acc1) + scalarDot(row1 + i, vector + i, tail);
+        out[r + 2] = avx2Sum(acc2) + scalarDot(row2 + i, vector + i, tail);
+        out[r + 3] = avx2Sum(acc3) + scalarDot(row3 + i, vector + i, tail);
+    }
+    for (; r < rows; ++r) {
+        out[r] = avx2Dot(matrix + r * dimension, vector, dimension);
+    }
+}
+
+// Dimension-specialized versions for the common embedding sizes: with the
+// trip count known, there is no tail and the compiler unrolls the inner loop
+template <size_t Dim>
+__attribute__((target("avx2,fma"))) inline float avx2DotFixed(const float* a, const float* b, size_t) {
+    static_assert(Dim % 32 == 0, "fixed kernels need whole 32-float blocks");
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+#pragma GCC unroll 8
+    for (size_t i = 0; i < Dim; i += 32) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+        acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(b + i + 16), acc2);
+        acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 24), _mm256_loadu_ps(b + i + 24), acc3);
+    }
+    return avx2Sum(_mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3)));
+}
+
+template <size_t Dim>
+__attribute__((target("avx2,fma"))) inline void avx2GemvFixed(const float* matrix, size_t rows, size_t, const float* vector, float* out) {
+    size_t r = 0;
+    for (; r + 4 <= rows; r += 4) {
+        const float* row0 = matrix + r * Dim;
+        const float* row1 = row0 + Dim;
+        const float* row2 = row1 + Dim;
+        const float* row3 = row2 + Dim;
+        __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+        __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+#pragma GCC unroll 16
+        for (size_t i = 0; i < Dim; i += 8) {
+            __m256 v = _mm256_loadu_ps(vector + i);
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(row0 + i), v, acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(row1 + i), v, acc1);
+            acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(row2 + i), v, acc2);
+            acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(row3 + i), v, acc3);
+        }
+        out[r] = avx2Sum(acc0);
+        out[r + 1] = avx2Sum(acc1);
+        out[r + 2] = avx2Sum(acc2);
+        out[r + 3] = avx2Sum(acc3);
+    }
+    for (; r < rows; ++r) {
+        out[r] = avx2DotFixed<Dim>(matrix + r * Dim, vector, Dim);
+    }
+}
+
+// 2 x 4 register tile: eight accumulators plus six loads fit the sixteen ymm registers
+__attribute__((target("avx2,fma"))) inline void avx2Gemm(const float* a, size_t aRows, const float* b, size_t bRows, size_t dimension, float* out) {
+    size_t i = 0;
+    for (; i + 2 <= aRows; i += 2) {
+        const float* a0 = a + i * dimension;
+        const float* a1 = a0 + dimension;
+        size_t j = 0;
+        for (; j + 4 <= bRows; j += 4) {
+            const float* b0 = b + j * dimension;
+            const float* b1 = b0 + dimension;
+            const float* b2 = b1 + dimension;
+            const float* b3 = b2 + dimension;
+            __m256 acc00 = _mm256_setzero_ps(), acc01 = _mm256_setzero_ps(), acc02 = _mm256_setzero_ps(), acc03 = _mm256_setzero_ps();
+            __m256 acc10 = _mm256_setzero_ps(), acc11 = _mm256_setzero_ps(), acc12 = _mm256_setzero_ps(), acc13 = _mm256_setzero_ps();
+            size_t k = 0;
+            for (; k + 8 <= dimension; k += 8) {
+                __m256 x0 = _mm256_loadu_ps(a0 + k), x1 = _mm256_loadu_ps(a1 + k);
+                __m256 y = _mm256_loadu_ps(b0 + k);
+                acc00 = _mm256_fmadd_ps(x0, y, acc00);
+                acc10 = _mm256_fmadd_ps(x1, y, acc10);
+                y = _mm256_loadu_ps(b1 + k);
+                acc01 = _mm256_fmadd_ps(x0, y, acc01);
+                acc11 = _mm256_fmadd_ps(x1, y, acc11);
+                y = _mm256_loadu_ps(b2 + k);
+                acc02 = _mm256_fmadd_ps(x0, y, acc02);
+                acc12 = _mm256_fmadd_ps(x1, y, acc12);
+                y = _mm256_loadu_ps(b3 + k);
+                acc03 = _mm256_fmadd_ps(x0, y, acc03);
+                acc13 = _mm256_fmadd_ps(x1, y, acc13);
+            }
+            size_t tail = dimension - k;
+            float* out0 = out + i * bRows + j;
+            float* out1 = out0 + bRows;
+            out0[0] = avx2Sum(acc00) + scalarDot(a0 + k, b0 + k, tail);
+            out0[1] = avx2Sum(acc01) + scalarDot(a0 + k, b1 + k, tail);
+            out0[2] = avx2Sum(acc02) + scalarDot(a0 + k, b2 + k, tail);
+            out0[3] = avx2Sum(acc03) + scalarDot(a0 + k, b3 + k, tail);
+            out1[0] = avx2Sum(acc10) + scalarDot(a1 + k, b0 + k, tail);
+            out1[1] = avx2Sum(acc11) + scalarDot(a1 + k, b1 + k, tail);
+            out1[2] = avx2Sum(acc12) + scalarDot(a1 + k, b2 + k, tail);
+            out1[3] = avx2Sum(acc13) + scalarDot(a1 + k, b3 + k, tail);
+        }
+        for (; j < bRows; ++j) {
+            out[i * bRows + j] = avx2Dot(a0, b + j * dimension, dimension);
+            out[(i + 1) * bRows + j] = avx2Dot(a1, b + j * dimension, dimension);
+        }
+    }
+    for (; i < aRows; ++i) {
+        avx2Gemv(b, bRows, dimension, a + i * dimension, out + i * bRows);
+    }
+}
+
+// Function to load the lanes of [p, p + remaining) that fit in one register, zeroing the rest
+__attribute__((target("avx512f"))) inline __m512 avx512Load(const float* p, size_t remaining) {
+    __mmask16 lanes = remaining >= 16 ? static_cast<__mmask16>(0xFFFF) : static_cast<__mmask16>((1u << remaining) - 1);
+    return _mm512_maskz_loadu_ps(lanes, p);
+}
+
+__attribute__((target("avx512f"))) inline float avx512Dot(const float* a, const float* b, size_t n) {
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+    }
+    // The tail is handled with masked loads instead of a scalar loop
+    for (; i < n; i += 16) {
+        acc0 = _mm512_fmadd_ps(avx512Load(a + i, n - i), avx512Load(b + i, n - i), acc0);
+    }
+    return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+}
+
+__attribute__((target("avx512f"))) inline void avx512Gemv(const float* matrix, size_t rows, size_t dimension, const float* vector, float* out) {
+    size_t r = 0;
+    for (; r + 4 <= rows; r += 4) {
+        const float* row0 = matrix + r * dimension;
+        const float* row1 = row0 + dimension;
+        const float* row2 = row1 + dimension;
+        const float* row3 = row2 + dimension;
+        __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+        __m512 acc2 = _mm512_setzero_ps(), acc3 = _mm512_setzero_ps();
+        for (size_t i = 0; i < dimension; i += 16) {
+            size_t remaining = dimension - i;
+            __m512 v = avx512Load(vector + i, remaining);
+            acc0 = _mm512_fmadd_ps(avx512Load(row0 + i, remaining), v, acc0);
+            acc1 = _mm512_fmadd_ps(avx512Load(row1 + i, remaining), v, acc1);
+            acc2 = _mm512_fmadd_ps(avx512Load(row2 + i, remaining), v, acc2);
+            acc3 = _mm512_fmadd_ps(avx512Load(row3 + i, remaining), v, acc3);
+        }
+        out[r] = _mm512_reduce_add_ps(acc0);
+        out[r + 1] = _mm512_reduce_add_ps(acc1);
+        out[r + 2] = _mm512_reduce_add_ps(acc2);
+        out[r + 3] = _mm512_reduce_add_ps(acc3);
+    }
+    for (; r < rows; ++r) {
+        out[r] = avx512Dot(matrix + r * dimension, vector, dimension);
+    }
+}
+
+template <size_t Dim>
+__attribute__((target("avx512f"))) inline float avx512DotFixed(const float* a, const float* b, size_t) {
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+#pragma GCC unroll 16
+    for (size_t i = 0; i < Dim; i += 32) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+    }
+    return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+}
+
+// No masked loads: every slice of a fixed dimension is a whole register
+template <size_t Dim>
+__attribute__((target("avx512f"))) inline void avx512GemvFixed(const float* matrix, size_t rows, size_t, const float* vector, float* out) {
+    size_t r = 0;
+    for (; r + 4 <= rows; r += 4) {
+        const float* row0 = matrix + r * Dim;
+        const float* row1 = row0 + Dim;
+        const float* row2 = row1 + Dim;
+        const float* row3 = row2 + Dim;
+        __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+        __m512 acc2 = _mm512_setzero_ps(), acc3 = _mm512_setzero_ps();
+#pragma GCC unroll 16
+        for (size_t i = 0; i < Dim; i += 16) {
+            __m512 v = _mm512_loadu_ps(vector + i);
+            acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(row0 + i), v, acc0);
+            acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(row1 + i), v, acc1);
+            acc2 = _mm512_fmadd_ps(_mm512_loadu_ps(row2 + i), v, acc2);
+            acc3 = _mm512_fmadd_ps(_mm512_loadu_ps(row3 + i), v, acc3);
+        }
+        out[r] = _mm512_reduce_add_ps(acc0);
+        out[r + 1] = _mm512_reduce_add_ps(acc1);
+        out[r + 2] = _mm512_reduce_add_ps(acc2);
+        out[r + 3] = _mm512_reduce_add_ps(acc3);
+    }
+    for (; r < rows; ++r) {
+        out[r] = avx512DotFixed<Dim>(matrix + r * Dim, vector, Dim);
+    }
+}
+
+// Function to accumulate one 16-lane slice of the dimension into a 2 x 4 tile
+__attribute__((target("avx512f"))) inline void avx512Tile(__m512 x0, __m512 x1, const float* const (&y)[4], size_t k, size_t remaining, __m512 (&acc)[2][4]) {
+    __m512 v = avx512Load(y[0] + k, remaining);
+    acc[0][0] = _mm512_fmadd_ps(x0, v, acc[0][0]);
+    acc[1][0] = _mm512_fmadd_ps(x1, v, acc[1][0]);
+    v = avx512Load(y[1] + k, remaining);
+    acc[0][1] = _mm512_fmadd_ps(x0, v, acc[0][1]);
+    acc[1][1] = _mm512_fmadd_ps(x1, v, acc[1][1]);
+    v = avx512Load(y[2] + k, remaining);
+    acc[0][2] = _mm512_fmadd_ps(x0, v, acc[0][2]);
+    acc[1][2] = _mm512_fmadd_ps(x1, v, acc[1][2]);
+    v = avx512Load(y[3] + k, remaining);
+    acc[0][3] = _mm512_fmadd_ps(x0, v, acc[0][3]);
+    acc[1][3] = _mm512_fmadd_ps(x1, v, acc[1][3]);
+}
+
+// 2 x 4 register tile like the AVX2 kernel; wider tiles measured slower here
+__attribute__((target("avx512f"))) inline void avx512Gemm(const float* a, size_t aRows, const float* b, size_t bRows, size_t dimension, float* out) {
+    size_t i = 0;
+    for (; i + 2 <= aRows; i += 2) {
+        const float* a0 = a + i * dimension;
+        const float* a1 = a0 + dimension;
+        size_t j = 0;
+        for (; j + 4 <= bRows; j += 4) {
+            const float* const y[4] = { b + j * dimension, b + (j + 1) * dimension, b + (j + 2) * dimension, b + (j + 3) * dimension };
+            __m512 acc[2][4];
+            for (int p = 0; p < 2; ++p) {
+                for (int q = 0; q < 4; ++q) {
+                    acc[p][q] = _mm512_setzero_ps();
+                }
+            }
+            size_t k = 0;
+            for (; k + 16 <= dimension; k += 16) {
+                avx512Tile(_mm512_loadu_ps(a0 + k), _mm512_loadu_ps(a1 + k), y, k, 16, acc);
+            }
+            // The tail is handled with masked loads instead of a scalar loop
+            if (k < dimension) {
+                size_t remaining = dimension - k;
+                avx512Tile(avx512Load(a0 + k, remaining), avx512Load(a1 + k, remaining), y, k, remaining, acc);
+            }
+            for (int q = 0; q < 4; ++q) {
+                out[i * bRows + j + q] = _mm512_reduce_add_ps(acc[0][q]);
+                out[(i + 1) * bRows + j + q] = _mm512_reduce_add_ps(acc[1][q]);
+            }
+        }
+        for (; j < bRows; ++j) {
+            out[i * bRows + j] = avx512Dot(a0, b + j * dimension, dimension);
+            out[(i + 1) * bRows + j] = avx512Dot(a1, b + j * dimension, dimension);
+        }
+    }
+    for (; i < aRows; ++i) {
+        avx512Gemv(b, bRows, dimension, a + i * dimension, out + i * bRows);
+    }
+}
+
+__attribute__((target("avx2"))) inline int32_t avx2SumInt(__m256i acc) {
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+    return _mm_cvtsi128_si32(half);
+}
+
+// Bytes are widened to 16 bits and multiplied in pairs; vpmaddubsw is avoided
+// because its 16-bit sums saturate at 255 * 127 * 2
+__attribute__((target("avx2"))) inline int32_t avx2ByteDot(const uint8_t* a, const int8_t* b, size_t n) {
+    __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i a0 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+        __m256i b0 = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        __m256i a1 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 16)));
+        __m256i b1 = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 16)));
+        acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(a0, b0));
+        acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(a1, b1));
+    }
+    for (; i + 16 <= n; i += 16) {
+        __m256i a0 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+        __m256i b0 = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(a0, b0));
+    }
+    return avx2SumInt(_mm256_add_epi32(acc0, acc1)) + scalarByteDot(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2"))) inline void avx2ByteGemv(const uint8_t* matrix, size_t rows, size_t dimension, const int8_t* vector, int32_t* out) {
+    for (size_t r = 0; r < rows; ++r) {
+        out[r] = avx2ByteDot(matrix + r * dimension, vector, dimension);
+    }
+}
+
+// AVX-VNNI (VEX encoded, also on CPUs without AVX-512): vpdpbusd multiplies
+// unsigned by signed bytes and adds each group of four straight into 32 bits
+__attribute__((target("avx2,avxvnni"))) inline int32_t avxVnniByteDot(const uint8_t* a, const int8_t* b, size_t n) {
+    __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        acc0 = _mm256_dpbusd_avx_epi32(acc0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+                                       _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+        acc1 = _mm256_dpbusd_avx_epi32(acc1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i + 32)),
+                                       _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i + 32)));
+    }
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm256_dpbusd_avx_epi32(acc0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+                                       _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+    }
+    return avx2SumInt(_mm256_add_epi32(acc0, acc1)) + scalarByteDot(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2,avxvnni"))) inline void avxVnniByteGemv(const uint8_t* matrix, size_t rows, size_t dimension, const int8_t* vector, int32_t* out) {
+    for (size_t r = 0; r < rows; ++r) {
+        out[r] = avxVnniByteDot(matrix + r * dimension, vector, dimension);
+    }
+}
+
+__attribute__((target("avx512f,avx512bw"))) inline int32_t avx512ByteDot(const uint8_t* a, const int8_t* b, size_t n) {
+    __m512i acc0 = _mm512_setzero_si512(), acc1 = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m512i a0 = _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)));
+        __m512i b0 = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+        __m512i a1 = _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i + 32)));
+        __m512i b1 = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i + 32)));
+        acc0 = _mm512_add_epi32(acc0, _mm512_madd_epi16(a0, b0));
+        acc1 = _mm512_add_epi32(acc1, _mm512_madd_epi16(a1, b1));
+    }
+    for (; i + 32 <= n; i += 32) {
+        __m512i a0 = _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)));
+        __m512i b0 = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+        acc0 = _mm512_add_epi32(acc0, _mm512_madd_epi16(a0, b0));
+    }
+    return _mm512_reduce_add_epi32(_mm512_add_epi32(acc0, acc1)) + scalarByteDot(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx512f,avx512bw"))) inline void avx512ByteGemv(const uint8_t* matrix, size_t rows, size_t dimension, const int8_t* vector, int32_t* out) {
+    for (size_t r = 0; r < rows; ++r) {
+        out[r] = avx512ByteDot(matrix + r * dimension, vector, dimension);
+    }
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vnni"))) inline int32_t avx512VnniByteDot(const uint8_t* a, const int8_t* b, size_t n) {
+    __m512i acc0 = _mm512_setzero_si512(), acc1 = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 128 <= n; i += 128) {
+        acc0 = _mm512_dpbusd_epi32(acc0, _mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i));
+        acc1 = _mm512_dpbusd_epi32(acc1, _mm512_loadu_si512(a + i + 64), _mm512_loadu_si512(b + i + 64));
+    }
+    // The tail is handled with masked loads instead of a scalar loop
+    for (; i < n; i += 64) {
+        size_t remaining = n - i;
+        __mmask64 lanes = remaining >= 64 ? ~0ULL : (1ULL << remaining) - 1;
+        acc0 = _mm512_dpbusd_epi32(acc0, _mm512_maskz_loadu_epi8(lanes, a + i), _mm512_maskz_loadu_epi8(lanes, b + i));
+    }
+    return _mm512_reduce_add_epi32(_mm512_add_epi32(acc0, acc1));
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vnni"))) inline void avx512VnniByteGemv(const uint8_t* matrix, size_t rows, size_t dimension, const int8_t* vector, int32_t* out) {
+    for (size_t r = 0; r < rows; ++r) {
+        out[r] = avx512VnniByteDot(matrix + r * dimension, vector, dimension);
+    }
+}
+
+#endif // CBIR_X86_KERNELS
+
+typedef float (*DotKernel)(const float*, const float*, size_t);
+typedef void (*GemvKernel)(const float*, size_t, size_t, const float*, float*);
+typedef void (*GemmKernel)(const float*, size_t, const float*, size_t, size_t, float*);
+typedef void (*ByteGemvKernel)(const uint8_t*, size_t, size_t, const int8_t*, int32_t*);
+
+// Function to pick the widest dot kernel the running CPU supports
+inline DotKernel selectDotKernel() {
+#ifdef CBIR_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return avx512Dot;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return avx2Dot;
+    }
+#endif
+    return scalarDot;
+}
+
+// Function to pick the widest matrix-vector kernel the running CPU supports
+inline GemvKernel selectGemvKernel() {
+#ifdef CBIR_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return avx512Gemv;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return avx2Gemv;
+    }
+#endif
+    return scalarGemv;
+}
+
+// Dot and matrix-vector kernels for one embedding dimension
+struct DotKernels {
+    DotKernel dot;
+    GemvKernel gemv;
+};
+
+// Function to pick the dimension-specialized kernels for Dim on the running CPU
+template <size_t Dim>
+inline DotKernels selectFixedDotKernels() {
+#ifdef CBIR_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return { avx512DotFixed<Dim>, avx512GemvFixed<Dim> };
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return { avx2DotFixed<Dim>, avx2GemvFixed<Dim> };
+    }
+#endif
+    return { scalarDot, scalarGemv };
+}
+
+// Function to pick the widest matrix-matrix kernel the running CPU supports
+inline GemmKernel selectGemmKernel() {
+#ifdef CBIR_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return avx512Gemm;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return avx2Gemm;
+    }
+#endif
+    return scalarGemm;
+}
+
+// Function to pick the widest byte matrix-vector kernel the running CPU supports
+inline ByteGemvKernel selectByteGemvKernel() {
+#ifdef CBIR_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512vnni") && __builtin_cpu_supports("avx512bw")) {
+        return avx512VnniByteGemv;
+    }
+    if (__builtin_cpu_supports("avxvnni")) {
+        return avxVnniByteGemv;
+    }
+    if (__builtin_cpu_supports("avx512bw")) {
+        return avx512ByteGemv;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return avx2ByteGemv;
+    }
+#endif
+    return scalarByteGemv;
+}
+
+// Function to look up the kernels for a dimension: the common embedding sizes
+// get specialized ones, any other size the generic kernels. Each set is
+// selected once, on first use.
+inline const DotKernels& dotKernelsFor(size_t dimension) {
+    struct Table {
+        DotKernels generic, fixed128, fixed256, fixed512, fixed768, fixed2048;
+    };
+    static const Table table = { { selectDotKernel(), selectGemvKernel() }, selectFixedDotKernels<128>(), selectFixedDotKernels<256>(),
+                                 selectFixedDotKernels<512>(), selectFixedDotKernels<768>(), selectFixedDotKernels<2048>() };
+    switch (dimension) {
+    case 128:
+        return table.fixed128;
+    case 256:
+        return table.fixed256;
+    case 512:
+        return table.fixed512;
+    case 768:
+        return table.fixed768;
+    case 2048:
+        return table.fixed2048;
+    default:
+        return table.generic;
+    }
+}
+
+} // namespace dot_kernels_detail
+
+// Function to compute the dot product of two contiguous float vectors
+inline float dotProduct(const float* a, const float* b, size_t n) {
+    return dot_kernels_detail::dotKernelsFor(n).dot(a, b, n);
+}
+
+// Function to multiply a row-major rows x dimension matrix by a vector: out[r] = dot(row r, vector)
+inline void matrixVectorProduct(const float* matrix, size_t rows, size_t dimension, const float* vector, float* out) {
+    dot_kernels_detail::dotKernelsFor(dimension).gemv(matrix, rows, dimension, vector, out);
+}
+
+// Function to multiply a row-major aRows x dimension matrix by the transpose of
+// a bRows x dimension one: out[i * bRows + j] = dot(a row i, b row j). Each
+// register tile reuses its loads of a and b across several products, so a
+// block of queries against a block of rows is bound by arithmetic instead of
+// memory; callers keep both blocks small enough to stay in cache.
+inline void matrixProductTransposed(const float* a, size_t aRows, const float* b, size_t bRows, size_t dimension, float* out) {
+    static const dot_kernels_detail::GemmKernel kernel = dot_kernels_detail::selectGemmKernel();
+    kernel(a, aRows, b, bRows, dimension, out);
+}
+
+// Function to multiply a row-major rows x dimension matrix of unsigned bytes by
+// a vector of signed bytes: out[r] = sum of row r[k] * vector[k] in 32 bits
+inline void byteMatrixVectorProduct(const uint8_t* matrix, size_t rows, size_t dimension, const int8_t* vector, int32_t* out) {
+    static const dot_kernels_detail::ByteGemvKernel kernel = dot_kernels_detail::selectByteGemvKernel();
+    kernel(matrix, rows, dimension, vector, out);
+}
+
+// Function to scale a vector to unit length; a zero vector stays zero
+inline void normalizeVector(const float* in, float* out, size_t n) {
+    float length = std::sqrt(dotProduct(in, in, n));
+    float scale = length > 0.0f ? 1.0f / length : 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = in[i] * scale;
+    }
+}
+
+// Function to compute 1 / length of a row. An all-zero row gets 0, so its
+// similarity to any query is 0 and its cosine distance 1 instead of NaN,
+// which would break TopN's ordering.
+inline float inverseRowLength(const float* row, size_t dimension) {
+    float length = std::sqrt(dotProduct(row, row, dimension));
+    return length > 0.0f ? 1.0f / length : 0.0f;
+}
+
+// Function to compute the cosine distance of one row to a unit-length query.
+// Rows that are not unit length have their own length divided out.
+inline double rowCosineDistance(const float* row, const float* unitQuery, size_t dimension, bool rowsNormalized) {
+    float similarity = dotProduct(row, unitQuery, dimension);
+    if (!rowsNormalized) {
+        similarity *= inverseRowLength(row, dimension);
+    }
+    return 1.0 - similarity;
+}
+
+// Function to compute the cosine distance of count rows to a unit-length
+// query: out[r] = 1 - cos(row r, query). Rows that are not unit length have
+// their own length divided out after the product.
+inline void cosineDistances(const float* rows, size_t count, size_t dimension, const float* unitQuery, bool rowsNormalized, float* out) {
+    matrixVectorProduct(rows, count, dimension, unitQuery, out);
+    for (size_t r = 0; r < count; ++r) {
+        float similarity = out[r];
+        if (!rowsNormalized) {
+            similarity *= inverseRowLength(rows + r * dimension, dimension);
+        }
+        out[r] = 1.0f - similarity;
+    }
+}
+
+#endif // DOT_KERNELS_H
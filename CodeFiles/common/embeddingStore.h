@@ -0,0 +1,277 @@
+/*
+
+Authored by: Aadhi Aadhavan Balasubramanian, Harishraj Udaya Bhaskar
+Date: 10/17/2026
+
+*/
+
+#ifndef EMBEDDING_STORE_H
+#define EMBEDDING_STORE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dotKernels.h"
+
+// Binary feature-vector store that replaces the ResNet CSV. The file is
+// memory-mapped and scanned in place: rows are contiguous floats and the
+// filename table is read as string views, so nothing is parsed or allocated
+// per row. Version 2 stores every row scaled to unit length, so a cosine
+// distance is one dot product; version 1 rows are stored as given.
+//
+// File layout (native byte order):
+//   EmbeddingStoreHeader, padded to kEmbeddingStoreAlignment bytes
+//   float    vectors[count][dimension]      at vectorsOffset
+//   uint64   nameOffsets[count + 1]         at namesOffset
+//   char     names[nameOffsets[count]]      (not NUL-terminated)
+struct EmbeddingStoreHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t dimension;
+    uint64_t count;
+    uint64_t vectorsOffset;
+    uint64_t namesOffset;
+    uint32_t normalized;  // 1 when every row has unit length (zero in version 1 files)
+    uint32_t reserved;
+};
+
+static const char kEmbeddingStoreMagic[8] = { 'C', 'B', 'I', 'R', 'E', 'M', 'B', '1' };
+static const uint32_t kEmbeddingStoreVersion = 2;
+static const uint64_t kEmbeddingStoreAlignment = 64;
+
+// Function to fingerprint a store file by its size and modification time.
+// Indexes built from a store record it, so one is not used with a store
+// rewritten since, even when the row count and dimension still match.
+inline uint64_t embeddingStoreFingerprint(const struct stat& info) {
+#ifdef __APPLE__
+    const struct timespec& modified = info.st_mtimespec;
+#else
+    const struct timespec& modified = info.st_mtim;
+#endif
+    uint64_t values[2] = { static_cast<uint64_t>(info.st_size),
+                           static_cast<uint64_t>(modified.tv_sec) * 1000000000 + static_cast<uint64_t>(modified.tv_nsec) };
+    uint64_t hash = 1469598103934665603ULL;
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(values);
+    for (size_t i = 0; i < sizeof(values); ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Function to check whether a file starts with the embedding store magic
+inline bool isEmbeddingStoreFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[8];
+    if (!in.read(magic, sizeof(magic))) {
+        return false;
+    }
+    return std::memcmp(magic, kEmbeddingStoreMagic, sizeof(magic)) == 0;
+}
+
+// Read-only, memory-mapped view of an embedding store file
+class EmbeddingStore {
+public:
+    EmbeddingStore() = default;
+    EmbeddingStore(const EmbeddingStore&) = delete;
+    EmbeddingStore& operator=(const EmbeddingStore&) = delete;
+    ~EmbeddingStore() { close(); }
+
+    bool open(const std::string& path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Error: Unable to open embedding store " << path << std::endl;
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(EmbeddingStoreHeader)) {
+            std::cerr << "Error: " << path << " is too small to be an embedding store." << std::endl;
+            ::close(fd);
+            return false;
+        }
+        mappedSize_ = static_cast<size_t>(info.st_size);
+        fingerprint_ = embeddingStoreFingerprint(info);
+        void* mapped = mmap(nullptr, mappedSize_, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            std::cerr << "Error: Unable to map embedding store " << path << std::endl;
+            mappedSize_ = 0;
+            return false;
+        }
+        base_ = static_cast<const char*>(mapped);
+        madvise(const_cast<char*>(base_), mappedSize_, MADV_SEQUENTIAL);
+
+        const EmbeddingStoreHeader* header = reinterpret_cast<const EmbeddingStoreHeader*>(base_);
+        if (std::memcmp(header->magic, kEmbeddingStoreMagic, sizeof(header->magic)) != 0 || header->version < 1 || header->version > kEmbeddingStoreVersion) {
+            std::cerr << "Error: " << path << " is not a supported embedding store." << std::endl;
+            close();
+            return false;
+        }
+        // Sizes are compared by division first, so a corrupt count cannot overflow them
+        uint64_t rowBytes = static_cast<uint64_t>(header->dimension) * sizeof(float);
+        if (header->vectorsOffset > mappedSize_ || header->namesOffset > mappedSize_ ||
+            (rowBytes > 0 && header->count > (mappedSize_ - header->vectorsOffset) / rowBytes) ||
+            header->count >= (mappedSize_ - header->namesOffset) / sizeof(uint64_t)) {
+            std::cerr << "Error: Embedding store " << path << " is truncated." << std::endl;
+            close();
+            return false;
+        }
+
+        dimension_ = header->dimension;
+        count_ = header->count;
+        normalized_ = header->version >= 2 && header->normalized != 0;
+        vectors_ = reinterpret_cast<const float*>(base_ + header->vectorsOffset);
+        uint64_t tableBytes = (count_ + 1) * sizeof(uint64_t);
+        nameOffsets_ = reinterpret_cast<const uint64_t*>(base_ + header->namesOffset);
+        names_ = base_ + header->namesOffset + tableBytes;
+
+        // Offsets must not decrease, and the last one must end inside the mapping, for name(i) to stay in it
+        bool ordered = nameOffsets_[0] == 0;
+        for (size_t i = 0; ordered && i < count_; ++i) {
+            ordered = nameOffsets_[i] <= nameOffsets_[i + 1];
+        }
+        if (!ordered || nameOffsets_[count_] > mappedSize_ - header->namesOffset - tableBytes) {
+            std::cerr << "Error: Embedding store " << path << " has a corrupt name table." << std::endl;
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (base_ != nullptr) {
+            munmap(const_cast<char*>(base_), mappedSize_);
+        }
+        base_ = nullptr;
+        mappedSize_ = 0;
+        dimension_ = 0;
+        count_ = 0;
+        normalized_ = false;
+        fingerprint_ = 0;
+    }
+
+    uint32_t dimension() const { return dimension_; }
+    size_t size() const { return count_; }
+    bool normalized() const { return normalized_; }
+    uint64_t fingerprint() const { return fingerprint_; }
+
+    const float* row(size_t i) const { return vectors_ + i * dimension_; }
+
+    std::string_view name(size_t i) const {
+        return std::string_view(names_ + nameOffsets_[i], nameOffsets_[i + 1] - nameOffsets_[i]);
+    }
+
+    // Function to find the row holding a filename, or -1 when it is missing
+    long find(std::string_view filename) const {
+        for (size_t i = 0; i < count_; ++i) {
+            if (name(i) == filename) {
+                return static_cast<long>(i);
+            }
+        }
+        return -1;
+    }
+
+private:
+    const char* base_ = nullptr;
+    size_t mappedSize_ = 0;
+    uint32_t dimension_ = 0;
+    size_t count_ = 0;
+    bool normalized_ = false;
+    uint64_t fingerprint_ = 0;
+    const float* vectors_ = nullptr;
+    const uint64_t* nameOffsets_ = nullptr;
+    const char* names_ = nullptr;
+};
+
+// Streaming writer: rows are scaled to unit length and go straight to disk,
+// only the filenames are kept until finish() writes the name table and the
+// final header. The file is written next to its destination and renamed over
+// it, so a failed conversion leaves the previous store in place.
+class EmbeddingStoreWriter {
+public:
+    bool open(const std::string& path, uint32_t dimension) {
+        path_ = path;
+        dimension_ = dimension;
+        count_ = 0;
+        nameOffsets_.assign(1, 0);
+        names_.clear();
+        unitRow_.assign(dimension, 0.0f);
+        out_.open(temporaryPath(), std::ios::binary | std::ios::trunc);
+        if (!out_.is_open()) {
+            std::cerr << "Error: Unable to open embedding store " << path << " for writing." << std::endl;
+            return false;
+        }
+        // Reserve the aligned header block, filled in by finish()
+        std::vector<char> padding(kEmbeddingStoreAlignment, 0);
+        out_.write(padding.data(), padding.size());
+        return static_cast<bool>(out_);
+    }
+
+    void append(std::string_view filename, const float* values) {
+        normalizeVector(values, unitRow_.data(), dimension_);
+        out_.write(reinterpret_cast<const char*>(unitRow_.data()), dimension_ * sizeof(float));
+        names_.append(filename.data(), filename.size());
+        nameOffsets_.push_back(names_.size());
+        ++count_;
+    }
+
+    bool finish() {
+        EmbeddingStoreHeader header = {};
+        std::memcpy(header.magic, kEmbeddingStoreMagic, sizeof(header.magic));
+        header.version = kEmbeddingStoreVersion;
+        header.dimension = dimension_;
+        header.count = count_;
+        header.vectorsOffset = kEmbeddingStoreAlignment;
+        header.namesOffset = kEmbeddingStoreAlignment + count_ * dimension_ * sizeof(float);
+        header.normalized = 1;
+
+        // Keep the offset table 8-byte aligned for the reader
+        uint64_t padding = (sizeof(uint64_t) - header.namesOffset % sizeof(uint64_t)) % sizeof(uint64_t);
+        header.namesOffset += padding;
+        out_.write("\0\0\0\0\0\0\0", padding);
+        out_.write(reinterpret_cast<const char*>(nameOffsets_.data()), nameOffsets_.size() * sizeof(uint64_t));
+        out_.write(names_.data(), names_.size());
+        out_.seekp(0);
+        out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out_.close();
+        if (!out_ || std::rename(temporaryPath().c_str(), path_.c_str()) != 0) {
+            std::cerr << "Error: Failed while writing embedding store " << path_ << std::endl;
+            std::remove(temporaryPath().c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // Function to drop a store that will not be finished, leaving the destination untouched
+    void abandon() {
+        out_.close();
+        std::remove(temporaryPath().c_str());
+    }
+
+    uint32_t dimension() const { return dimension_; }
+    size_t size() const { return count_; }
+
+private:
+    std::string temporaryPath() const { return path_ + ".tmp"; }
+
+    std::ofstream out_;
+    std::string path_;
+    uint32_t dimension_ = 0;
+    size_t count_ = 0;
+    std::vector<uint64_t> nameOffsets_;
+    std::string names_;
+    std::vector<float> unitRow_;
+};
+
+#endif // EMBEDDING_STORE_H
@@ -0,0 +1,311 @@
+/*
+
+Authored by: Aadhi Aadhavan Balasubramanian, Harishraj Udaya Bhaskar
+Date: 10/17/2026
+
+*/
+
+#ifndef FEATURE_CSV_H
+#define FEATURE_CSV_H
+
+#include <algorithm>
+#include <charconv>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "parallelScan.h"
+
+// Rows of the ResNet feature-vector CSV look like
+//   pic.0001.jpg,0.0123,-0.4,...
+// a filename followed by one float per column. The parser below works on a
+// view of the line: the filename is returned as a view and the values are
+// written into a buffer the caller reuses, so a row costs no allocations.
+
+namespace feature_csv_detail {
+
+// Function to parse the float at the start of [cursor, end), returning the
+// first character after it, or nullptr when there is none. A leading '+' is
+// accepted, as strtof does. std::from_chars is used where the standard
+// library has the floating-point overloads (__cpp_lib_to_chars). Otherwise
+// the value, which ends at the next comma, is copied into a terminated buffer
+// for strtof, so a row at the very end of a mapping is not read past.
+inline const char* parseFloat(const char* cursor, const char* end, float& value) {
+    if (cursor != end && *cursor == '+') {
+        ++cursor;
+        if (cursor != end && (*cursor == '-' || *cursor == '+')) {
+            return nullptr;
+        }
+    }
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    std::from_chars_result parsed = std::from_chars(cursor, end, value);
+    return parsed.ec == std::errc() ? parsed.ptr : nullptr;
+#else
+    const char* stop = std::find(cursor, end, ',');
+    char token[64];
+    size_t length = static_cast<size_t>(stop - cursor);
+    if (length == 0 || length >= sizeof(token) || *cursor == ' ' || *cursor == '\t') {
+        return nullptr;
+    }
+    std::memcpy(token, cursor, length);
+    token[length] = '\0';
+    char* parsedEnd = nullptr;
+    errno = 0;
+    value = std::strtof(token, &parsedEnd);
+    if (parsedEnd == token || errno == ERANGE) {
+        return nullptr;
+    }
+    return cursor + (parsedEnd - token);
+#endif
+}
+
+} // namespace feature_csv_detail
+
+// Function to split one CSV row into its filename and values. Spaces before
+// a value and a trailing '\r' are ignored. Returns false when the row has no
+// value columns or a value does not parse.
+inline bool parseFeatureRow(std::string_view line, std::string_view& name, std::vector<float>& values) {
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    size_t comma = line.find(',');
+    if (comma == std::string_view::npos) {
+        return false;
+    }
+    name = line.substr(0, comma);
+
+    values.clear();
+    const char* cursor = line.data() + comma;
+    const char* end = line.data() + line.size();
+    while (cursor != end) {
+        // cursor sits on the comma in front of the next value
+        ++cursor;
+        while (cursor != end && (*cursor == ' ' || *cursor == '\t')) {
+            ++cursor;
+        }
+        float value = 0.0f;
+        const char* parsed = feature_csv_detail::parseFloat(cursor, end, value);
+        if (parsed == nullptr || (parsed != end && *parsed != ',')) {
+            return false;
+        }
+        values.push_back(value);
+        cursor = parsed;
+    }
+    return true;
+}
+
+// Parsed CSV rows: vectors back to back and the filenames in one string, so
+// holding a whole file costs a few large buffers instead of one per row
+struct FeatureRows {
+    uint32_t dimension = 0;
+    std::vector<float> features;  // size() x dimension, row-major
+    std::string names;
+    std::vector<size_t> nameEnds;
+
+    size_t size() const { return nameEnds.size(); }
+
+    const float* row(size_t i) const { return features.data() + i * dimension; }
+
+    std::string_view name(size_t i) const {
+        size_t begin = i == 0 ? 0 : nameEnds[i - 1];
+        return std::string_view(names.data() + begin, nameEnds[i] - begin);
+    }
+
+    // Function to find the row holding a filename, or -1 when it is missing
+    long find(std::string_view filename) const {
+        for (size_t i = 0; i < size(); ++i) {
+            if (name(i) == filename) {
+                return static_cast<long>(i);
+            }
+        }
+        return -1;
+    }
+
+    void add(std::string_view filename, const float* values) {
+        features.insert(features.end(), values, values + dimension);
+        names.append(filename.data(), filename.size());
+        nameEnds.push_back(names.size());
+    }
+
+    void add(const FeatureRows& rows) {
+        for (size_t i = 0; i < rows.size(); ++i) {
+            add(rows.name(i), rows.row(i));
+        }
+    }
+
+    void clear() {
+        dimension = 0;
+        features.clear();
+        names.clear();
+        nameEnds.clear();
+    }
+};
+
+namespace feature_csv_detail {
+
+// One newline-aligned piece of the file, parsed on its own. Line numbers are
+// relative to the chunk until the chunks are put back in order.
+struct ParsedChunk {
+    FeatureRows rows;
+    size_t lines = 0;
+    size_t firstRowLine = 0;
+    size_t errorLine = 0;     // 0 when every line parsed
+    size_t errorValues = 0;   // value count of a row with the wrong dimension
+    bool formatError = false;
+};
+
+// Function to parse every line in [begin, end); blank lines are skipped and
+// parsing stops at the first bad row
+inline void parseChunk(const char* begin, const char* end, ParsedChunk& chunk) {
+    chunk.rows.clear();
+    chunk.lines = chunk.firstRowLine = chunk.errorLine = chunk.errorValues = 0;
+    chunk.formatError = false;
+
+    std::vector<float> values;
+    while (begin != end) {
+        const char* newline = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+        const char* lineEnd = newline ? newline : end;
+        std::string_view line(begin, lineEnd - begin);
+        begin = newline ? newline + 1 : end;
+        ++chunk.lines;
+        if (line.empty() || line == "\r") {
+            continue;
+        }
+
+        std::string_view name;
+        if (!parseFeatureRow(line, name, values)) {
+            chunk.errorLine = chunk.lines;
+            chunk.formatError = true;
+            return;
+        }
+        if (chunk.rows.size() == 0) {
+            chunk.rows.dimension = static_cast<uint32_t>(values.size());
+            chunk.firstRowLine = chunk.lines;
+        } else if (values.size() != chunk.rows.dimension) {
+            chunk.errorLine = chunk.lines;
+            chunk.errorValues = values.size();
+            return;
+        }
+        chunk.rows.add(name, values.data());
+    }
+}
+
+} // namespace feature_csv_detail
+
+// Function to parse a feature CSV on the pool and hand its rows to
+// consume(const FeatureRows&) in file order. The file is memory-mapped and
+// cut at newlines into chunks of about chunkBytes; each round parses one
+// chunk per worker, then consumes them on the calling thread, so memory stays
+// bounded by the pool size however large the file is. The first row fixes
+// the dimension for the whole file. consume returns false to stop. Returns
+// false after printing an error.
+template <typename Consume>
+bool forEachFeatureCsvChunk(const std::string& path, ThreadPool& pool, Consume consume, size_t chunkBytes = size_t(32) << 20) {
+    using namespace feature_csv_detail;
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error: Unable to open CSV file " << path << std::endl;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        std::cerr << "Error: CSV file is empty." << std::endl;
+        ::close(fd);
+        return false;
+    }
+    size_t fileSize = static_cast<size_t>(info.st_size);
+    void* mapped = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Error: Unable to map CSV file " << path << std::endl;
+        return false;
+    }
+    const char* base = static_cast<const char*>(mapped);
+    madvise(mapped, fileSize, MADV_SEQUENTIAL);
+
+    // Chunks start right after a newline so no row is split between workers
+    std::vector<size_t> starts(1, 0);
+    for (size_t target = chunkBytes; target < fileSize;) {
+        const char* newline = static_cast<const char*>(std::memchr(base + target, '\n', fileSize - target));
+        if (newline == nullptr || newline + 1 == base + fileSize) {
+            break;
+        }
+        starts.push_back(newline + 1 - base);
+        target = starts.back() + chunkBytes;
+    }
+    starts.push_back(fileSize);
+    size_t chunkCount = starts.size() - 1;
+
+    std::vector<ParsedChunk> round(pool.size());
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t lineBase = 0;
+    uint32_t dimension = 0;
+    bool ok = true;
+    for (size_t first = 0; ok && first < chunkCount; first += round.size()) {
+        size_t count = std::min(round.size(), chunkCount - first);
+        parallelFor(pool, count, [&](size_t k) {
+            parseChunk(base + starts[first + k], base + starts[first + k + 1], round[k]);
+        }, 1);
+
+        for (size_t k = 0; ok && k < count; ++k) {
+            const ParsedChunk& chunk = round[k];
+            if (chunk.rows.size() > 0 && dimension == 0) {
+                dimension = chunk.rows.dimension;
+            } else if (chunk.rows.size() > 0 && chunk.rows.dimension != dimension) {
+                std::cerr << "Error: Line " << lineBase + chunk.firstRowLine << " has " << chunk.rows.dimension
+                          << " values, expected " << dimension << "." << std::endl;
+                ok = false;
+                break;
+            }
+            if (chunk.errorLine != 0) {
+                if (chunk.formatError) {
+                    std::cerr << "Error: Invalid CSV format on line " << lineBase + chunk.errorLine << "." << std::endl;
+                } else {
+                    std::cerr << "Error: Line " << lineBase + chunk.errorLine << " has " << chunk.errorValues
+                              << " values, expected " << dimension << "." << std::endl;
+                }
+                ok = false;
+                break;
+            }
+            if (chunk.rows.size() > 0 && !consume(chunk.rows)) {
+                ok = false;
+                break;
+            }
+            lineBase += chunk.lines;
+        }
+
+        // The parsed rows are copies, so the mapped pages of this round can go
+        size_t from = starts[first] / pageSize * pageSize;
+        madvise(const_cast<char*>(base) + from, starts[first + count] - from, MADV_DONTNEED);
+    }
+    munmap(mapped, fileSize);
+
+    if (ok && dimension == 0) {
+        std::cerr << "Error: CSV file is empty." << std::endl;
+        return false;
+    }
+    return ok;
+}
+
+// Function to read a whole feature CSV into rows, parsing it on the pool
+inline bool loadFeatureCsv(const std::string& path, ThreadPool& pool, FeatureRows& rows) {
+    rows.clear();
+    return forEachFeatureCsvChunk(path, pool, [&](const FeatureRows& chunk) {
+        rows.dimension = chunk.dimension;
+        rows.add(chunk);
+        return true;
+    });
+}
+
+#endif // FEATURE_CSV_H
@@ -0,0 +1,417 @@
+/*
+
+Authored by: Aadhi Aadhavan Balasubramanian, Harishraj Udaya Bhaskar
+Date: 10/17/2026
+
+*/
+
+#ifndef FEATURE_INDEX_H
+#define FEATURE_INDEX_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/stat.h>
+
+#include "binaryFile.h"
+
+// What an index remembers about a database file to tell whether it changed
+// since its features were extracted. A zero stamp (version 1 indexes) never
+// matches a real file, so such records are re-extracted on the next update.
+struct FileStamp {
+    int64_t mtime = 0;  // modification time in nanoseconds
+    uint64_t size = 0;
+    uint64_t hash = 0;  // hashBytes of the file contents
+};
+
+// On-disk feature index shared by the query binaries. Every record holds the
+// path of a database image and one fixed-length row of features, so a query
+// only has to compute the target's features and compare rows. Rows are
+// floats, or bytes for features that are 8-bit pixels (Question1's patches).
+//
+// File layout (native byte order):
+//   char[8]  magic "CBIRIDX1"
+//   uint32   format version
+//   uint32   kind length, followed by the kind string
+//   uint32   dimension (values per row)
+//   uint32   bytes per value, 4 (float) or 1 (uint8); version 3 only, older files hold floats
+//   uint64   record count
+//   value    features[count][dimension]
+//   per record: uint32 path length, followed by the path bytes
+// Version 2 and later append, per record:
+//   int64 mtime, uint64 size, uint64 hash
+//   uint8 tombstone (1 = the file was deleted)
+// Tombstoned rows stay in place so an update does not renumber the others;
+// they are dropped when the index is loaded for querying, and from the file
+// once they make up a quarter of it.
+struct FeatureIndex {
+    std::string kind;                      // feature type tag, checked at load time
+    uint32_t dimension = 0;                // values per row
+    uint32_t valueBytes = sizeof(float);   // 4 for float rows, 1 for uint8 rows
+    std::vector<std::string> paths;
+    std::vector<uint8_t> features;         // count x rowBytes(), row-major
+    std::vector<FileStamp> stamps;
+    std::vector<uint8_t> tombstones;
+
+    size_t size() const { return paths.size(); }
+
+    size_t rowBytes() const { return static_cast<size_t>(dimension) * valueBytes; }
+
+    const float* row(size_t i) const { return reinterpret_cast<const float*>(features.data() + i * rowBytes()); }
+
+    const uint8_t* byteRow(size_t i) const { return features.data() + i * rowBytes(); }
+
+    // values holds one row in the index's value type
+    void add(const std::string& path, const void* values, const FileStamp& stamp = FileStamp()) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(values);
+        paths.push_back(path);
+        features.insert(features.end(), bytes, bytes + rowBytes());
+        stamps.push_back(stamp);
+        tombstones.push_back(0);
+    }
+};
+
+static const char kFeatureIndexMagic[8] = { 'C', 'B', 'I', 'R', 'I', 'D', 'X', '1' };
+static const uint32_t kFeatureIndexVersion = 3;
+
+// Function to check whether a file starts with the feature index magic
+inline bool isFeatureIndexFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[8];
+    if (!in.read(magic, sizeof(magic))) {
+        return false;
+    }
+    return std::memcmp(magic, kFeatureIndexMagic, sizeof(magic)) == 0;
+}
+
+// Function to hash file contents for change detection (not cryptographic)
+inline uint64_t hashBytes(const unsigned char* data, size_t size) {
+    const uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+    uint64_t hash = size * multiplier;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ (word * 0xBF58476D1CE4E5B9ull)) * multiplier;
+        hash ^= hash >> 29;
+    }
+    for (; i < size; ++i) {
+        hash = (hash ^ data[i]) * multiplier;
+    }
+    hash ^= hash >> 32;
+    return hash == 0 ? 1 : hash;
+}
+
+// Function to read a file's size and modification time, false if it cannot be stat'ed
+inline bool statFile(const std::string& path, FileStamp& stamp) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        return false;
+    }
+#ifdef __APPLE__
+    const struct timespec& modified = info.st_mtimespec;
+#else
+    const struct timespec& modified = info.st_mtim;
+#endif
+    stamp.mtime = static_cast<int64_t>(modified.tv_sec) * 1000000000 + modified.tv_nsec;
+    stamp.size = static_cast<uint64_t>(info.st_size);
+    return true;
+}
+
+// Function to hash a whole file, 0 if it cannot be read
+inline uint64_t hashFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        return 0;
+    }
+    std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    return hashBytes(bytes.data(), bytes.size());
+}
+
+// Function to drop tombstoned records
+inline void compactFeatureIndex(FeatureIndex& index) {
+    size_t kept = 0;
+    for (size_t i = 0; i < index.size(); ++i) {
+        if (index.tombstones[i]) {
+            continue;
+        }
+        if (kept != i) {
+            index.paths[kept] = std::move(index.paths[i]);
+            std::memmove(&index.features[kept * index.rowBytes()], index.byteRow(i), index.rowBytes());
+            index.stamps[kept] = index.stamps[i];
+        }
+        index.tombstones[kept] = 0;
+        ++kept;
+    }
+    index.paths.resize(kept);
+    index.features.resize(kept * index.rowBytes());
+    index.stamps.resize(kept);
+    index.tombstones.resize(kept);
+}
+
+// Function to write a feature index to disk. The file is written next to its
+// destination and renamed over it, so readers never see a partial index.
+inline bool saveFeatureIndex(const FeatureIndex& index, const std::string& path) {
+    std::string temporaryPath = path + ".tmp";
+    std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Error: Unable to open index file " << path << " for writing." << std::endl;
+        return false;
+    }
+
+    uint32_t kindLength = static_cast<uint32_t>(index.kind.size());
+    uint64_t count = index.size();
+    out.write(kFeatureIndexMagic, sizeof(kFeatureIndexMagic));
+    out.write(reinterpret_cast<const char*>(&kFeatureIndexVersion), sizeof(kFeatureIndexVersion));
+    out.write(reinterpret_cast<const char*>(&kindLength), sizeof(kindLength));
+    out.write(index.kind.data(), kindLength);
+    out.write(reinterpret_cast<const char*>(&index.dimension), sizeof(index.dimension));
+    out.write(reinterpret_cast<const char*>(&index.valueBytes), sizeof(index.valueBytes));
+    out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    out.write(reinterpret_cast<const char*>(index.features.data()), index.features.size());
+    for (const std::string& imagePath : index.paths) {
+        uint32_t pathLength = static_cast<uint32_t>(imagePath.size());
+        out.write(reinterpret_cast<const char*>(&pathLength), sizeof(pathLength));
+        out.write(imagePath.data(), pathLength);
+    }
+    for (const FileStamp& stamp : index.stamps) {
+        out.write(reinterpret_cast<const char*>(&stamp.mtime), sizeof(stamp.mtime));
+        out.write(reinterpret_cast<const char*>(&stamp.size), sizeof(stamp.size));
+        out.write(reinterpret_cast<const char*>(&stamp.hash), sizeof(stamp.hash));
+    }
+    out.write(reinterpret_cast<const char*>(index.tombstones.data()), index.tombstones.size());
+
+    out.close();
+    if (!out || std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "Error: Failed while writing index file " << path << std::endl;
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Function to read a feature index from disk, rejecting indexes of another
+// kind, row length or value size; an empty expectedKind or a zero
+// expectedDimension or expectedValueBytes accepts any. Versions 1 to 3 are
+// accepted. Tombstoned records are dropped unless keepTombstones is set,
+// which only an index update needs.
+inline bool loadFeatureIndex(const std::string& path, const std::string& expectedKind, uint32_t expectedDimension,
+                             uint32_t expectedValueBytes, FeatureIndex& index, bool keepTombstones = false) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "Error: Unable to open index file " << path << std::endl;
+        return false;
+    }
+
+    char magic[8];
+    uint32_t version = 0;
+    uint32_t kindLength = 0;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(&version), sizeof(version));
+    in.read(reinterpret_cast<char*>(&kindLength), sizeof(kindLength));
+    if (!in || std::memcmp(magic, kFeatureIndexMagic, sizeof(magic)) != 0 || version < 1 || version > kFeatureIndexVersion ||
+        kindLength > bytesLeft(in)) {
+        std::cerr << "Error: " << path << " is not a supported feature index." << std::endl;
+        return false;
+    }
+
+    index.kind.assign(kindLength, '\0');
+    in.read(&index.kind[0], kindLength);
+    if (!expectedKind.empty() && index.kind != expectedKind) {
+        std::cerr << "Error: Index " << path << " holds '" << index.kind << "' features, expected '" << expectedKind << "'." << std::endl;
+        return false;
+    }
+
+    uint64_t count = 0;
+    in.read(reinterpret_cast<char*>(&index.dimension), sizeof(index.dimension));
+    index.valueBytes = sizeof(float);
+    if (version >= 3) {
+        in.read(reinterpret_cast<char*>(&index.valueBytes), sizeof(index.valueBytes));
+    }
+    in.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (!in || (expectedDimension != 0 && index.dimension != expectedDimension)) {
+        std::cerr << "Error: Index " << path << " holds rows of " << index.dimension << " values, expected " << expectedDimension << "." << std::endl;
+        return false;
+    }
+    if ((index.valueBytes != sizeof(float) && index.valueBytes != 1) || (expectedValueBytes != 0 && index.valueBytes != expectedValueBytes)) {
+        std::cerr << "Error: Index " << path << " holds " << index.valueBytes << "-byte values, expected " << expectedValueBytes << "." << std::endl;
+        return false;
+    }
+
+    // Every record holds its row and at least a path length, so a count the file cannot hold is rejected before allocating
+    uint64_t left = bytesLeft(in);
+    if (count > left / (static_cast<uint64_t>(index.rowBytes()) + sizeof(uint32_t))) {
+        std::cerr << "Error: Index file " << path << " is truncated." << std::endl;
+        return false;
+    }
+    index.features.resize(count * index.rowBytes());
+    in.read(reinterpret_cast<char*>(index.features.data()), index.features.size());
+    left -= index.features.size();
+
+    index.paths.resize(count);
+    for (std::string& imagePath : index.paths) {
+        uint32_t pathLength = 0;
+        in.read(reinterpret_cast<char*>(&pathLength), sizeof(pathLength));
+        if (!in || left < sizeof(pathLength) || pathLength > left - sizeof(pathLength)) {
+            std::cerr << "Error: Index file " << path << " is truncated." << std::endl;
+            return false;
+        }
+        imagePath.assign(pathLength, '\0');
+        in.read(&imagePath[0], pathLength);
+        left -= sizeof(pathLength) + pathLength;
+    }
+
+    index.stamps.assign(count, FileStamp());
+    index.tombstones.assign(count, 0);
+    if (version >= 2) {
+        for (FileStamp& stamp : index.stamps) {
+            in.read(reinterpret_cast<char*>(&stamp.mtime), sizeof(stamp.mtime));
+            in.read(reinterpret_cast<char*>(&stamp.size), sizeof(stamp.size));
+            in.read(reinterpret_cast<char*>(&stamp.hash), sizeof(stamp.hash));
+        }
+        in.read(reinterpret_cast<char*>(index.tombstones.data()), index.tombstones.size());
+    }
+
+    if (!in) {
+        std::cerr << "Error: Index file " << path << " is truncated." << std::endl;
+        return false;
+    }
+    if (!keepTombstones) {
+        compactFeatureIndex(index);
+    }
+    return true;
+}
+
+// Files an update has to (re-)extract, and what happened to the rest
+struct IndexUpdate {
+    std::vector<std::string> paths;  // files to extract
+    std::vector<long> rows;          // row each file replaces, -1 for a new file
+    std::vector<FileStamp> stamps;   // size and mtime now; the caller fills in the hash when it reads the file
+    size_t unchanged = 0;            // size and mtime matched
+    size_t touched = 0;              // mtime changed but the contents hash the same
+    size_t removed = 0;              // deleted files, tombstoned
+};
+
+// Function to diff the files in a database directory against an index.
+// Unchanged files keep their rows, files whose metadata changed are hashed
+// and kept if their contents did not, and rows of deleted files are
+// tombstoned. Everything else is returned for extraction.
+inline IndexUpdate planIndexUpdate(FeatureIndex& index, const std::vector<std::string>& paths) {
+    IndexUpdate update;
+    std::unordered_map<std::string, size_t> rowOf;
+    for (size_t i = 0; i < index.size(); ++i) {
+        if (!index.tombstones[i]) {
+            rowOf[index.paths[i]] = i;
+        }
+    }
+
+    std::vector<char> seen(index.size(), 0);
+    for (const std::string& path : paths) {
+        FileStamp now;
+        if (!statFile(path, now)) {
+            continue;
+        }
+        std::unordered_map<std::string, size_t>::const_iterator found = rowOf.find(path);
+        if (found == rowOf.end()) {
+            update.paths.push_back(path);
+            update.rows.push_back(-1);
+            update.stamps.push_back(now);
+            continue;
+        }
+
+        size_t row = found->second;
+        FileStamp& stored = index.stamps[row];
+        seen[row] = 1;
+        if (stored.mtime == now.mtime && stored.size == now.size) {
+            ++update.unchanged;
+            continue;
+        }
+        if (stored.size == now.size && stored.hash != 0) {
+            now.hash = hashFile(path);
+            if (now.hash == stored.hash) {
+                stored = now;
+                ++update.touched;
+                continue;
+            }
+        }
+        update.paths.push_back(path);
+        update.rows.push_back(static_cast<long>(row));
+        update.stamps.push_back(now);
+    }
+
+    for (size_t i = 0; i < index.size(); ++i) {
+        if (!index.tombstones[i] && !seen[i]) {
+            index.tombstones[i] = 1;
+            ++update.removed;
+        }
+    }
+    return update;
+}
+
+// Function to store the features extracted for update.paths[i], one row in
+// the index's value type; values is null when the file could not be read,
+// which tombstones a replaced row
+inline void applyIndexUpdate(FeatureIndex& index, const IndexUpdate& update, size_t i, const void* values) {
+    long row = update.rows[i];
+    if (row < 0) {
+        if (values) {
+            index.add(update.paths[i], values, update.stamps[i]);
+        }
+        return;
+    }
+    if (!values) {
+        index.tombstones[row] = 1;
+        return;
+    }
+    std::memcpy(&index.features[row * index.rowBytes()], values, index.rowBytes());
+    index.stamps[row] = update.stamps[i];
+    index.tombstones[row] = 0;
+}
+
+// Function to store float rows that hold whole byte values as uint8 rows, as
+// patch indexes written before version 3 did
+inline void convertFeatureIndexToBytes(FeatureIndex& index) {
+    if (index.valueBytes == 1) {
+        return;
+    }
+    std::vector<uint8_t> bytes(index.size() * index.dimension);
+    for (size_t i = 0; i < bytes.size(); ++i) {
+        float value;
+        std::memcpy(&value, &index.features[i * sizeof(float)], sizeof(value));
+        bytes[i] = static_cast<uint8_t>(std::max(0.0f, std::min(255.0f, std::round(value))));
+    }
+    index.features.swap(bytes);
+    index.valueBytes = 1;
+}
+
+// Function to drop tombstones once they make up a quarter of the index
+inline void compactFeatureIndexIfSparse(FeatureIndex& index) {
+    size_t dead = 0;
+    for (uint8_t tombstone : index.tombstones) {
+        dead += tombstone;
+    }
+    if (dead > 0 && 4 * dead >= index.size()) {
+        compactFeatureIndex(index);
+    }
+}
+
+// Function to print what an index build or update did
+inline void printIndexUpdate(const IndexUpdate& update, size_t extracted, const FeatureIndex& index, const std::string& path) {
+    size_t live = 0;
+    for (uint8_t tombstone : index.tombstones) {
+        live += !tombstone;
+    }
+    std::cout << "Extracted " << extracted << " of " << update.paths.size() << " new or changed images ("
+              << update.unchanged << " unchanged, " << update.touched << " touched, " << update.removed
+              << " removed); " << path << " holds " << live << " images" << std::endl;
+}
+
+#endif // FEATURE_INDEX_H
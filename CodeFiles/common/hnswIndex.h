@@ -0,0 +1,473 @@
+/*
+
+Authored by: Aadhi Aadhavan Balasubramanian, Harishraj Udaya Bhaskar
+Date: 10/17/2026
+
+*/
+
+#ifndef HNSW_INDEX_H
+#define HNSW_INDEX_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "dotKernels.h"
+#include "approximateIndex.h"
+#include "parallelScan.h"
+#include "topN.h"
+
+// Hierarchical navigable small-world (HNSW) graph over the rows of an
+// embedding store, searched by cosine distance. Every row is a node on layer
+// 0 and, with geometrically falling probability, on the layers above; each
+// layer links a node to its closest neighbours. A query walks greedily down
+// the sparse upper layers and then runs a best-first search of width
+// efSearch on layer 0, so it touches a few thousand rows instead of all of
+// them. The graph only holds links, the vectors are read from the store.
+//
+// File layout (native byte order):
+//   char[8]  magic "CBIRHNSW"
+//   uint32   format version
+//   uint32   dimension
+//   uint64   node count
+//   uint64   fingerprint of the store (embeddingStoreFingerprint)
+//   uint32   M (links per node on the upper layers, 2M on layer 0)
+//   int32    top layer
+//   uint32   entry point
+//   uint8    levels[count]
+//   uint32   layer 0 links[count][2M + 1]     (link count, then the links)
+//   uint32   upper links[node][level][M + 1]  for nodes with level > 0, in node order
+
+// Settings of the graph: links per node, and the candidate list widths used
+// while building and while searching
+struct HnswOptions {
+    size_t M = 16;
+    size_t efConstruction = 200;
+    size_t efSearch = 64;
+};
+
+static const char kHnswIndexMagic[8] = { 'C', 'B', 'I', 'R', 'H', 'N', 'S', 'W' };
+static const uint32_t kHnswIndexVersion = 2;
+
+class HnswIndex {
+public:
+    uint32_t dimension() const { return dimension_; }
+    size_t size() const { return count_; }
+    uint64_t storeFingerprint() const { return storeFingerprint_; }
+    void setStoreFingerprint(uint64_t fingerprint) { storeFingerprint_ = fingerprint; }
+
+    // Function to point the graph at the rows it was built from; rows that are
+    // not unit length have their lengths computed once here
+    void attach(const float* rows, bool rowsNormalized) {
+        rows_ = rows;
+        inverseNorms_.clear();
+        if (!rowsNormalized) {
+            inverseNorms_.resize(count_);
+            for (size_t i = 0; i < count_; ++i) {
+                inverseNorms_[i] = inverseRowLength(row(i), dimension_);
+            }
+        }
+    }
+
+    // Function to build the graph over count rows. Nodes are inserted on the
+    // pool; each insert locks only the nodes whose links it reads or rewrites.
+    // False when the store has more rows than a uint32 node id can name.
+    bool build(const float* rows, size_t count, size_t dimension, bool rowsNormalized, const HnswOptions& options, ThreadPool& pool) {
+        if (count > UINT32_MAX) {
+            std::cerr << "Error: An HNSW graph holds at most " << UINT32_MAX << " rows, the store has " << count << "." << std::endl;
+            return false;
+        }
+        count_ = count;
+        dimension_ = static_cast<uint32_t>(dimension);
+        M_ = std::max<size_t>(2, options.M);
+        maxM0_ = 2 * M_;
+        attach(rows, rowsNormalized);
+
+        // Levels are drawn up front so every node's link storage exists before the parallel inserts
+        std::mt19937 random(100);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        double levelScale = 1.0 / std::log(static_cast<double>(M_));
+        levels_.resize(count_);
+        upper_.assign(count_, std::vector<uint32_t>());
+        for (size_t i = 0; i < count_; ++i) {
+            int level = std::min(kMaxLevel, static_cast<int>(-std::log(1.0 - uniform(random)) * levelScale));
+            levels_[i] = static_cast<uint8_t>(level);
+            if (level > 0) {
+                upper_[i].assign(static_cast<size_t>(level) * (M_ + 1), 0);
+            }
+        }
+        level0_.assign(count_ * (maxM0_ + 1), 0);
+        if (count_ == 0) {
+            return true;
+        }
+
+        entryPoint_ = 0;
+        topLevel_ = levels_[0];
+        nodeLocks_.reset(new std::mutex[kNodeLocks]);
+        parallelFor(pool, count_ - 1, [&](size_t i) { insert(static_cast<uint32_t>(i + 1), options.efConstruction); });
+        nodeLocks_.reset();        return true;
+    }
+
+    // Function to find the N rows closest to a unit-length query, closest first
+    std::vector<TopN<size_t>::Entry> search(const float* unitQuery, int N, size_t efSearch) const {
+        std::vector<TopN<size_t>::Entry> matches;
+        if (count_ == 0 || N <= 0) {
+            return matches;
+        }
+        uint32_t entry = entryPoint_;
+        float entryDistance = distanceTo(unitQuery, entry);
+        for (int level = topLevel_; level > 0; --level) {
+            greedyStep(unitQuery, level, entry, entryDistance);
+        }
+        std::vector<Candidate> closest = searchLayer(unitQuery, entry, entryDistance, std::max<size_t>(efSearch, N), 0);
+        for (size_t i = 0; i < closest.size() && matches.size() < static_cast<size_t>(N); ++i) {
+            matches.push_back({ closest[i].first, closest[i].second });
+        }
+        return matches;
+    }
+
+    bool save(const std::string& path) const {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            std::cerr << "Error: Unable to open HNSW index " << path << " for writing." << std::endl;
+            return false;
+        }
+        uint64_t count = count_;
+        uint32_t M = static_cast<uint32_t>(M_);
+        int32_t topLevel = topLevel_;
+        writeIndexHeader(out, kHnswIndexMagic, kHnswIndexVersion, dimension_);
+        out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        out.write(reinterpret_cast<const char*>(&storeFingerprint_), sizeof(storeFingerprint_));
+        out.write(reinterpret_cast<const char*>(&M), sizeof(M));
+        out.write(reinterpret_cast<const char*>(&topLevel), sizeof(topLevel));
+        out.write(reinterpret_cast<const char*>(&entryPoint_), sizeof(entryPoint_));
+        out.write(reinterpret_cast<const char*>(levels_.data()), levels_.size());
+        out.write(reinterpret_cast<const char*>(level0_.data()), level0_.size() * sizeof(uint32_t));
+        for (const std::vector<uint32_t>& links : upper_) {
+            out.write(reinterpret_cast<const char*>(links.data()), links.size() * sizeof(uint32_t));
+        }
+        out.close();
+        if (!out) {
+            std::cerr << "Error: Failed while writing HNSW index " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Function to read a graph back; attach() must be called before searching
+    bool load(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) {
+            std::cerr << "Error: Unable to open HNSW index " << path << std::endl;
+            return false;
+        }
+        uint64_t count = 0;
+        uint32_t M = 0;
+        int32_t topLevel = 0;
+        if (!readIndexHeader(in, path, "HNSW", kHnswIndexMagic, kHnswIndexVersion, dimension_)) {
+            return false;
+        }
+        in.read(reinterpret_cast<char*>(&count), sizeof(count));
+        in.read(reinterpret_cast<char*>(&storeFingerprint_), sizeof(storeFingerprint_));
+        in.read(reinterpret_cast<char*>(&M), sizeof(M));
+        in.read(reinterpret_cast<char*>(&topLevel), sizeof(topLevel));
+        in.read(reinterpret_cast<char*>(&entryPoint_), sizeof(entryPoint_));
+        if (!in || M < 2 || M > kMaxM || topLevel < 0 || topLevel > kMaxLevel || count > UINT32_MAX ||
+            count > bytesLeft(in) / (1 + (2 * static_cast<uint64_t>(M) + 1) * sizeof(uint32_t))) {
+            std::cerr << "Error: HNSW index " << path << " has an invalid header." << std::endl;
+            return false;
+        }
+        count_ = count;
+        M_ = M;
+        maxM0_ = 2 * M_;
+        topLevel_ = topLevel;
+        levels_.resize(count_);
+        in.read(reinterpret_cast<char*>(levels_.data()), levels_.size());
+        level0_.resize(count_ * (maxM0_ + 1));
+        in.read(reinterpret_cast<char*>(level0_.data()), level0_.size() * sizeof(uint32_t));
+        upper_.assign(count_, std::vector<uint32_t>());
+        for (size_t i = 0; in && i < count_; ++i) {
+            if (levels_[i] > 0) {
+                upper_[i].resize(static_cast<size_t>(levels_[i]) * (M_ + 1));
+                in.read(reinterpret_cast<char*>(upper_[i].data()), upper_[i].size() * sizeof(uint32_t));
+            }
+        }
+        if (!in) {
+            std::cerr << "Error: HNSW index " << path << " is truncated." << std::endl;
+            return false;
+        }
+        if (!linksValid()) {
+            std::cerr << "Error: HNSW index " << path << " links nodes outside its store." << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    typedef std::pair<float, uint32_t> Candidate;  // (distance, node)
+
+    static const int kMaxLevel = 16;
+    static const uint32_t kMaxM = 1 << 16;
+    static const size_t kNodeLocks = 1 << 16;
+
+    // Visited marks for one thread's searches; bumping the generation clears them
+    struct VisitedNodes {
+        std::vector<uint32_t> marks;
+        uint32_t generation = 0;
+
+        void reset(size_t count) {
+            if (marks.size() != count || ++generation == 0) {
+                marks.assign(count, 0);
+                generation = 1;
+            }
+        }
+        bool visit(uint32_t node) {
+            if (marks[node] == generation) {
+                return false;
+            }
+            marks[node] = generation;
+            return true;
+        }
+    };
+
+    const float* row(size_t node) const { return rows_ + node * dimension_; }
+
+    float distanceTo(const float* unitQuery, uint32_t node) const {
+        float similarity = dotProduct(unitQuery, row(node), dimension_);
+        if (!inverseNorms_.empty()) {
+            similarity *= inverseNorms_[node];
+        }
+        return 1.0f - similarity;
+    }
+
+    float distanceBetween(uint32_t a, uint32_t b) const {
+        float similarity = dotProduct(row(a), row(b), dimension_);
+        if (!inverseNorms_.empty()) {
+            similarity *= inverseNorms_[a] * inverseNorms_[b];
+        }
+        return 1.0f - similarity;
+    }
+
+    // Links of a node on a layer: the count, followed by up to maxLinks(level) nodes
+    uint32_t* links(uint32_t node, int level) {
+        return level == 0 ? level0_.data() + node * (maxM0_ + 1) : upper_[node].data() + (level - 1) * (M_ + 1);
+    }
+    const uint32_t* links(uint32_t node, int level) const {
+        return level == 0 ? level0_.data() + node * (maxM0_ + 1) : upper_[node].data() + (level - 1) * (M_ + 1);
+    }
+    size_t maxLinks(int level) const { return level == 0 ? maxM0_ : M_; }
+
+    std::mutex* lockOf(uint32_t node) const { return nodeLocks_ ? &nodeLocks_[node % kNodeLocks] : nullptr; }
+
+    // Function to copy a node's links, under its lock while the graph is being built
+    void readLinks(uint32_t node, int level, std::vector<uint32_t>& out) const {
+        std::unique_lock<std::mutex> lock;
+        if (std::mutex* mutex = lockOf(node)) {
+            lock = std::unique_lock<std::mutex>(*mutex);
+        }
+        const uint32_t* list = links(node, level);
+        out.assign(list + 1, list + 1 + list[0]);
+    }
+
+    // Function to check a loaded graph before it is searched: the entry point
+    // reaches the top layer, no node holds more links than fit, and every link
+    // leads to a node that exists on the link's layer
+    bool linksValid() const {
+        if (count_ == 0) {
+            return true;
+        }
+        if (entryPoint_ >= count_ || topLevel_ > levels_[entryPoint_]) {
+            return false;
+        }
+        for (size_t node = 0; node < count_; ++node) {
+            if (levels_[node] > kMaxLevel) {
+                return false;
+            }
+            for (int level = 0; level <= levels_[node]; ++level) {
+                const uint32_t* list = links(static_cast<uint32_t>(node), level);
+                if (list[0] > maxLinks(level)) {
+                    return false;
+                }
+                for (uint32_t i = 1; i <= list[0]; ++i) {
+                    if (list[i] >= count_ || levels_[list[i]] < level) {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    // Function to move entry to its closest neighbour on a layer until none is closer
+    void greedyStep(const float* query, int level, uint32_t& entry, float& entryDistance) const {
+        std::vector<uint32_t> neighbours;
+        for (bool moved = true; moved;) {
+            moved = false;
+            readLinks(entry, level, neighbours);
+            for (uint32_t neighbour : neighbours) {
+                float distance = distanceTo(query, neighbour);
+                if (distance < entryDistance) {
+                    entry = neighbour;
+                    entryDistance = distance;
+                    moved = true;
+                }
+            }
+        }
+    }
+
+    // Function to run a best-first search of width ef on one layer, returning
+    // the ef closest nodes found, closest first
+    std::vector<Candidate> searchLayer(const float* query, uint32_t entry, float entryDistance, size_t ef, int level) const {
+        thread_local VisitedNodes visited;
+        visited.reset(count_);
+        std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> frontier;
+        std::priority_queue<Candidate> closest;
+        frontier.push({ entryDistance, entry });
+        closest.push({ entryDistance, entry });
+        visited.visit(entry);
+
+        std::vector<uint32_t> neighbours;
+        while (!frontier.empty()) {
+            Candidate current = frontier.top();
+            if (current.first > closest.top().first && closest.size() >= ef) {
+                break;
+            }
+            frontier.pop();
+            readLinks(current.second, level, neighbours);
+            for (uint32_t neighbour : neighbours) {
+                if (!visited.visit(neighbour)) {
+                    continue;
+                }
+                float distance = distanceTo(query, neighbour);
+                if (closest.size() < ef || distance < closest.top().first) {
+                    frontier.push({ distance, neighbour });
+                    closest.push({ distance, neighbour });
+                    if (closest.size() > ef) {
+                        closest.pop();
+                    }
+                }
+            }
+        }
+
+        std::vector<Candidate> result(closest.size());
+        for (size_t i = result.size(); i-- > 0; closest.pop()) {
+            result[i] = closest.top();
+        }
+        return result;
+    }
+
+    // Function to keep at most limit of the candidates (closest first), skipping any
+    // that is closer to an already kept neighbour than to the base node, so links
+    // spread out in different directions instead of bunching up
+    std::vector<uint32_t> selectNeighbours(const std::vector<Candidate>& candidates, size_t limit) const {
+        std::vector<uint32_t> kept;
+        for (const Candidate& candidate : candidates) {
+            if (kept.size() >= limit) {
+                break;
+            }
+            bool diverse = true;
+            for (uint32_t other : kept) {
+                if (distanceBetween(candidate.second, other) < candidate.first) {
+                    diverse = false;
+                    break;
+                }
+            }
+            if (diverse) {
+                kept.push_back(candidate.second);
+            }
+        }
+        return kept;
+    }
+
+    // Function to link node back from a neighbour, pruning the neighbour's links when full
+    void addBackLink(uint32_t neighbour, uint32_t node, int level) {
+        std::lock_guard<std::mutex> lock(*lockOf(neighbour));
+        uint32_t* list = links(neighbour, level);
+        size_t limit = maxLinks(level);
+        if (list[0] < limit) {
+            list[1 + list[0]++] = node;
+            return;
+        }
+        std::vector<Candidate> candidates;
+        candidates.push_back({ distanceBetween(neighbour, node), node });
+        for (uint32_t i = 0; i < list[0]; ++i) {
+            candidates.push_back({ distanceBetween(neighbour, list[1 + i]), list[1 + i] });
+        }
+        std::sort(candidates.begin(), candidates.end());
+        std::vector<uint32_t> kept = selectNeighbours(candidates, limit);
+        list[0] = static_cast<uint32_t>(kept.size());
+        std::copy(kept.begin(), kept.end(), list + 1);
+    }
+
+    // Function to insert one node into a graph that already holds node 0
+    void insert(uint32_t node, size_t efConstruction) {
+        std::vector<float> query(dimension_);
+        normalizeVector(row(node), query.data(), dimension_);
+        int level = levels_[node];
+
+        // A node that opens a new top layer holds the global lock for its whole insert
+        std::unique_lock<std::mutex> topLock(topMutex_);
+        int topLevel = topLevel_;
+        uint32_t entry = entryPoint_;
+        if (level <= topLevel) {
+            topLock.unlock();
+        }
+
+        float entryDistance = distanceTo(query.data(), entry);
+        for (int l = topLevel; l > level; --l) {
+            greedyStep(query.data(), l, entry, entryDistance);
+        }
+        for (int l = std::min(level, topLevel); l >= 0; --l) {
+            std::vector<Candidate> candidates = searchLayer(query.data(), entry, entryDistance, efConstruction, l);
+            std::vector<uint32_t> neighbours = selectNeighbours(candidates, M_);
+            {
+                std::lock_guard<std::mutex> lock(*lockOf(node));
+                uint32_t* list = links(node, l);
+                list[0] = static_cast<uint32_t>(neighbours.size());
+                std::copy(neighbours.begin(), neighbours.end(), list + 1);
+            }
+            for (uint32_t neighbour : neighbours) {
+                addBackLink(neighbour, node, l);
+            }
+            entry = candidates.front().second;
+            entryDistance = candidates.front().first;
+        }
+
+        if (level > topLevel) {
+            topLevel_ = level;
+            entryPoint_ = node;
+        }
+    }
+
+    size_t count_ = 0;
+    uint32_t dimension_ = 0;
+    uint64_t storeFingerprint_ = 0;
+    size_t M_ = 16;
+    size_t maxM0_ = 32;
+    int topLevel_ = 0;
+    uint32_t entryPoint_ = 0;
+    std::vector<uint8_t> levels_;
+    std::vector<uint32_t> level0_;
+    std::vector<std::vector<uint32_t>> upper_;
+    const float* rows_ = nullptr;
+    std::vector<float> inverseNorms_;
+    std::unique_ptr<std::mutex[]> nodeLocks_;
+    std::mutex topMutex_;
+};
+
+// Function to check whether a file starts with the HNSW index magic
+inline bool isHnswIndexFile(const std::string& path) {
+    return hasIndexMagic(path, kHnswIndexMagic);
+}
+
+#endif // HNSW_INDEX_H
@@ -0,0 +1,227 @@
+/*
+
+Authored by: Aadhi Aadhavan Balasubramanian, Harishraj Udaya Bhaskar
+Date: 10/17/2026
+
+*/
+
+#ifndef IMAGE_DECODE_H
+#define IMAGE_DECODE_H
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "chiSquared.h"
+#include "cliOptions.h"
+#include "pipeline.h"
+
+// Histogram features only need the color distribution, so database images
+// can be decoded at a fraction of their size. JPEGs are scaled inside the
+// DCT by OpenCV's IMREAD_REDUCED_COLOR_* modes, which cuts both decode time
+// and memory; other formats are decoded in full and shrunk afterwards.
+struct DecodeOptions {
+    int reduction = 1;  // 1, 2, 4 or 8: decode at 1/reduction of the original size
+    int maxSide = 0;    // when > 0, pick the largest reduction keeping the longer side >= maxSide
+};
+
+// Function to take "--reduce N" and "--max-side N" out of argv
+inline bool takeDecodeOptions(int& argc, char** argv, DecodeOptions& options) {
+    size_t reduction = 1, maxSide = 0;
+    if (!takeCountOption(argc, argv, "--reduce", 1, reduction) || !takeCountOption(argc, argv, "--max-side", 0, maxSide)) {
+        return false;
+    }
+    if (reduction != 1 && reduction != 2 && reduction != 4 && reduction != 8) {
+        std::cerr << "Error: --reduce must be 1, 2, 4 or 8." << std::endl;
+        return false;
+    }
+    options.reduction = static_cast<int>(reduction);
+    options.maxSide = static_cast<int>(std::min<size_t>(maxSide, INT_MAX));
+    return true;
+}
+
+// Function to tag an index kind with the decode options its rows were built
+// with, so rows extracted at one scale are never compared with, or updated
+// by, rows extracted at another. Full-size decoding adds nothing, so indexes
+// written before the tag keep their kind.
+inline std::string decodeKind(const std::string& kind, const DecodeOptions& options) {
+    if (options.maxSide > 0) {
+        return kind + "@max-side-" + std::to_string(options.maxSide);
+    }
+    if (options.reduction > 1) {
+        return kind + "@reduce-" + std::to_string(options.reduction);
+    }
+    return kind;
+}
+
+// Function to split a tagged index kind back into the feature kind and its
+// decode options; false when the tag is not one decodeKind writes
+inline bool parseDecodeKind(const std::string& tagged, std::string& kind, DecodeOptions& options) {
+    options = DecodeOptions();
+    size_t at = tagged.find('@');
+    kind = tagged.substr(0, at);
+    if (at == std::string::npos) {
+        return true;
+    }
+    std::string tag = tagged.substr(at + 1);
+    size_t value = 0;
+    if (tag.compare(0, 9, "max-side-") == 0 && parseCount(tag.substr(9), value) && value > 0 && value <= INT_MAX) {
+        options.maxSide = static_cast<int>(value);
+        return true;
+    }
+    if (tag.compare(0, 7, "reduce-") == 0 && parseCount(tag.substr(7), value) && (value == 2 || value == 4 || value == 8)) {
+        options.reduction = static_cast<int>(value);
+        return true;
+    }
+    return false;
+}
+
+// Function to read the pixel size from a JPEG or PNG header without decoding
+inline bool readImageSize(const std::vector<uchar>& bytes, int& width, int& height) {
+    size_t size = bytes.size();
+    if (size >= 24 && bytes[0] == 0x89 && bytes[1] == 'P' && bytes[2] == 'N' && bytes[3] == 'G') {
+        width = (bytes[16] << 24) | (bytes[17] << 16) | (bytes[18] << 8) | bytes[19];
+        height = (bytes[20] << 24) | (bytes[21] << 16) | (bytes[22] << 8) | bytes[23];
+        return true;
+    }
+    if (size < 4 || bytes[0] != 0xFF || bytes[1] != 0xD8) {
+        return false;
+    }
+
+    // Walk the JPEG marker segments up to the first start-of-frame
+    size_t i = 2;
+    while (i + 9 < size) {
+        if (bytes[i] != 0xFF) {
+            return false;
+        }
+        uchar marker = bytes[i + 1];
+        if (marker == 0xFF) {
+            ++i;
+            continue;
+        }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+            i += 2;
+            continue;
+        }
+        bool startOfFrame = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+        if (startOfFrame) {
+            height = (bytes[i + 5] << 8) | bytes[i + 6];
+            width = (bytes[i + 7] << 8) | bytes[i + 8];
+            return true;
+        }
+        i += 2 + ((bytes[i + 2] << 8) | bytes[i + 3]);
+    }
+    return false;
+}
+
+// Function to map a reduction factor to the matching imdecode flag
+inline int reducedColorFlag(int reduction) {
+    switch (reduction) {
+        case 2: return cv::IMREAD_REDUCED_COLOR_2;
+        case 4: return cv::IMREAD_REDUCED_COLOR_4;
+        case 8: return cv::IMREAD_REDUCED_COLOR_8;
+        default: return cv::IMREAD_COLOR;
+    }
+}
+
+// Function to pick the reduction for an image of the given size
+inline int chooseReduction(const DecodeOptions& options, int width, int height) {
+    if (options.maxSide <= 0) {
+        return options.reduction;
+    }
+    int longerSide = std::max(width, height);
+    int reduction = 8;
+    while (reduction > 1 && longerSide / reduction < options.maxSide) {
+        reduction /= 2;
+    }
+    return reduction;
+}
+
+// Function to decode an image file already read into memory, empty on failure
+inline cv::Mat decodeImage(const std::vector<uchar>& bytes, const DecodeOptions& options = DecodeOptions()) {
+    if (bytes.empty()) {
+        return cv::Mat();
+    }
+    try {
+        if (options.reduction == 1 && options.maxSide <= 0) {
+            return cv::imdecode(bytes, cv::IMREAD_COLOR);
+        }
+
+        // With an unknown size, decode in full and shrink by the same power of two
+        int width = 0, height = 0;
+        if (!readImageSize(bytes, width, height)) {
+            cv::Mat image = cv::imdecode(bytes, cv::IMREAD_COLOR);
+            int reduction = image.empty() ? 1 : chooseReduction(options, image.cols, image.rows);
+            if (reduction > 1) {
+                cv::resize(image, image, cv::Size(image.cols / reduction, image.rows / reduction), 0, 0, cv::INTER_AREA);
+            }
+            return image;
+        }
+        return cv::imdecode(bytes, reducedColorFlag(chooseReduction(options, width, height)));
+    } catch (const cv::Exception&) {
+        return cv::Mat();
+    }
+}
+
+// How far a histogram feature moves when images are decoded with reduced options
+struct DecodeDrift {
+    size_t images = 0;
+    double meanDistance = 0.0;   // mean chi-squared distance, full vs reduced
+    double maxDistance = 0.0;
+    double fullMillis = 0.0;     // total decode time
+    double reducedMillis = 0.0;
+    double fullPixels = 0.0;     // total decoded pixels
+    double reducedPixels = 0.0;
+};
+
+// Function to decode every file both ways and compare the features computed
+// by feature(image), which must return a continuous float histogram
+template <typename Feature>
+DecodeDrift measureDecodeDrift(const std::vector<std::string>& paths, const DecodeOptions& options, Feature feature) {
+    typedef std::chrono::steady_clock Clock;
+    DecodeDrift drift;
+    for (const std::string& path : paths) {
+        std::vector<uchar> bytes = readFileBytes(path);
+        Clock::time_point start = Clock::now();
+        cv::Mat full = decodeImage(bytes);
+        Clock::time_point middle = Clock::now();
+        cv::Mat reduced = decodeImage(bytes, options);
+        Clock::time_point end = Clock::now();
+        if (full.empty() || reduced.empty()) {
+            continue;
+        }
+
+        cv::Mat fullFeature = feature(full);
+        cv::Mat reducedFeature = feature(reduced);
+        double distance = chiSquaredDistance(fullFeature.ptr<float>(), reducedFeature.ptr<float>(), fullFeature.total());
+        drift.meanDistance += distance;
+        drift.maxDistance = std::max(drift.maxDistance, distance);
+        drift.fullMillis += std::chrono::duration<double, std::milli>(middle - start).count();
+        drift.reducedMillis += std::chrono::duration<double, std::milli>(end - middle).count();
+        drift.fullPixels += static_cast<double>(full.total());
+        drift.reducedPixels += static_cast<double>(reduced.total());
+        ++drift.images;
+    }
+    if (drift.images > 0) {
+        drift.meanDistance /= drift.images;
+    }
+    return drift;
+}
+
+// Function to print a drift report for one feature
+inline void printDecodeDrift(const std::string& featureName, const DecodeDrift& drift) {
+    std::cout << featureName << ": " << drift.images << " images" << std::endl;
+    if (drift.images == 0) {
+        return;
+    }
+    std::cout << "  chi-squared drift vs full decode: mean " << drift.meanDistance << ", max " << drift.maxDistance << std::endl;
+    std::cout << "  decode time: full " << drift.fullMillis / drift.images << " ms/image, reduced "
+              << drift.reducedMillis / drift.images << " ms/image" << std::endl;
+    std::cout << "  decoded pixels: full " << drift.fullPixels / drift.images << ", reduced "
+              << drift.reducedPixels / drift.images << " per image" << std::endl;
+}
+
+#endif // IMAGE_DECODE_H
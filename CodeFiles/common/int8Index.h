@@ -0,0 +1,247 @@
+/*
+
+Authored by: Aadhi Aadhavan Balasubramanian, Harishraj Udaya Bhaskar
+Date: 10/17/2026
+
+*/
+
+#ifndef INT8_INDEX_H
+#define INT8_INDEX_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "dotKernels.h"
+#include "approximateIndex.h"
+#include "parallelScan.h"
+#include "topN.h"
+
+// Scalar-quantized (int8) copy of the rows of an embedding store. Every
+// dimension of the unit-length rows gets its own scale, calibrated on a
+// sample so that one stray value does not flatten the rest. Each value is
+// stored as one byte, a quarter of the float row, so an exhaustive scan reads
+// 4x less memory. The query is quantized once per search with the row scales
+// folded in. A row's similarity is then one integer dot product (VNNI or
+// widened AVX2 multiply-adds) times the query scale. The top candidates can
+// be re-ranked exactly against the float rows of the store.
+//
+// File layout (native byte order):
+//   char[8]  magic "CBIRSQ81"
+//   uint32   format version
+//   uint32   dimension
+//   uint64   row count of the store
+//   uint64   fingerprint of the store (embeddingStoreFingerprint)
+//   float    scales[dimension]
+//   uint8    codes[rowCount][dimension]   (round(value / scale) + 128)
+struct Int8Index {
+    uint32_t dimension = 0;
+    uint64_t rowCount = 0;
+    uint64_t storeFingerprint = 0;
+    std::vector<float> scales;
+    std::vector<uint8_t> codes;
+
+    const uint8_t* code(size_t row) const { return codes.data() + row * dimension; }
+};
+
+// A query quantized against the scales of an index
+struct Int8Query {
+    std::vector<int8_t> values;
+    float scale = 0.0f;   // similarity = scale * (code . values - offset)
+    int32_t offset = 0;   // 128 * sum of values, undoing the bias of the codes
+};
+
+static const char kInt8IndexMagic[8] = { 'C', 'B', 'I', 'R', 'S', 'Q', '8', '1' };
+static const uint32_t kInt8IndexVersion = 2;
+
+namespace int8_index_detail {
+
+// Rows sampled to calibrate the scales, and the share of each dimension's
+// magnitudes that must fit without clipping
+const size_t kCalibrationRows = 65536;
+const double kCalibrationQuantile = 0.9999;
+
+// Rows scored per byte matrix-vector product
+const size_t kScanBlockRows = 1024;
+
+inline uint8_t quantize(float value, float scale) {
+    if (scale <= 0.0f) {
+        return 128;
+    }
+    float level = std::round(value / scale);
+    return static_cast<uint8_t>(std::max(-127.0f, std::min(127.0f, level)) + 128.0f);
+}
+
+} // namespace int8_index_detail
+
+// Function to calibrate per-dimension scales on a sample of unit-length rows
+// and quantize every row
+inline void buildInt8Index(const float* rows, size_t count, size_t dimension, ThreadPool& pool, Int8Index& index) {
+    using namespace int8_index_detail;
+    index.dimension = static_cast<uint32_t>(dimension);
+    index.rowCount = count;
+    index.scales.assign(dimension, 0.0f);
+    index.codes.assign(count * dimension, 128);
+    if (count == 0) {
+        return;
+    }
+
+    std::mt19937 random(12345);
+    std::vector<size_t> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), random);
+    size_t sampleCount = std::min(count, kCalibrationRows);
+    std::vector<float> sample(sampleCount * dimension);
+    for (size_t i = 0; i < sampleCount; ++i) {
+        normalizeVector(rows + order[i] * dimension, sample.data() + i * dimension, dimension);
+    }
+
+    // Each scale maps the calibration quantile of its dimension's magnitudes to 127
+    parallelFor(pool, dimension, [&](size_t k) {
+        std::vector<float> magnitudes(sampleCount);
+        for (size_t i = 0; i < sampleCount; ++i) {
+            magnitudes[i] = std::fabs(sample[i * dimension + k]);
+        }
+        size_t rank = std::min(sampleCount - 1, static_cast<size_t>(kCalibrationQuantile * sampleCount));
+        std::nth_element(magnitudes.begin(), magnitudes.begin() + rank, magnitudes.end());
+        index.scales[k] = magnitudes[rank] / 127.0f;
+    });
+
+    size_t blocks = (count + kScanBlockRows - 1) / kScanBlockRows;
+    parallelFor(pool, blocks, [&](size_t block) {
+        std::vector<float> unitRow(dimension);
+        size_t last = std::min(count, (block + 1) * kScanBlockRows);
+        for (size_t i = block * kScanBlockRows; i < last; ++i) {
+            normalizeVector(rows + i * dimension, unitRow.data(), dimension);
+            uint8_t* code = index.codes.data() + i * dimension;
+            for (size_t k = 0; k < dimension; ++k) {
+                code[k] = quantize(unitRow[k], index.scales[k]);
+            }
+        }
+    }, 1);
+}
+
+// Function to quantize a unit-length query: the row scales are multiplied in
+// first, so the integer dot product needs no per-dimension work
+inline void quantizeInt8Query(const Int8Index& index, const float* unitQuery, Int8Query& query) {
+    size_t dimension = index.dimension;
+    std::vector<float> scaled(dimension);
+    float largest = 0.0f;
+    for (size_t k = 0; k < dimension; ++k) {
+        scaled[k] = unitQuery[k] * index.scales[k];
+        largest = std::max(largest, std::fabs(scaled[k]));
+    }
+    query.values.assign(dimension, 0);
+    query.scale = largest / 127.0f;
+    query.offset = 0;
+    if (largest == 0.0f) {
+        return;
+    }
+    for (size_t k = 0; k < dimension; ++k) {
+        query.values[k] = static_cast<int8_t>(std::round(scaled[k] / query.scale));
+        query.offset += 128 * query.values[k];
+    }
+}
+
+// Function to estimate the cosine distances of rows [first, first + count) to a quantized query
+inline void int8CosineDistances(const Int8Index& index, const Int8Query& query, size_t first, size_t count,
+                                std::vector<int32_t>& products, float* out) {
+    products.resize(count);
+    byteMatrixVectorProduct(index.code(first), count, index.dimension, query.values.data(), products.data());
+    for (size_t r = 0; r < count; ++r) {
+        out[r] = 1.0f - query.scale * static_cast<float>(products[r] - query.offset);
+    }
+}
+
+// Function to rank every row by its quantized distance to a unit-length
+// query, closest first. When rerank is larger than zero, the best
+// max(rerank, N) rows are scored again exactly against the store rows;
+// rowsNormalized tells whether those have unit length.
+inline std::vector<TopN<size_t>::Entry> searchInt8Index(const Int8Index& index, const float* rows, bool rowsNormalized,
+                                                        const float* unitQuery, int N, size_t rerank, ThreadPool& pool) {
+    using namespace int8_index_detail;
+    Int8Query query;
+    quantizeInt8Query(index, unitQuery, query);
+    int candidates = rerank > 0 ? std::max(N, static_cast<int>(rerank)) : N;
+
+    size_t blocks = (index.rowCount + kScanBlockRows - 1) / kScanBlockRows;
+    std::vector<TopN<size_t>> partials = parallelScan(pool, blocks, TopN<size_t>(candidates), [&](size_t block, TopN<size_t>& best) {
+        thread_local std::vector<int32_t> products;
+        thread_local std::vector<float> distances;
+        size_t first = block * kScanBlockRows;
+        size_t blockRows = std::min<size_t>(kScanBlockRows, index.rowCount - first);
+        distances.resize(blockRows);
+        int8CosineDistances(index, query, first, blockRows, products, distances.data());
+        for (size_t r = 0; r < blockRows; ++r) {
+            best.push(distances[r], first + r);
+        }
+    }, 1);
+    std::vector<TopN<size_t>::Entry> matches = mergeTopN(partials).sorted();
+    if (rerank == 0) {
+        return matches;
+    }
+
+    return rerankExact(rows, rowsNormalized, unitQuery, index.dimension, matches, N);
+}
+
+// Function to check whether a file starts with the int8 index magic
+inline bool isInt8IndexFile(const std::string& path) {
+    return hasIndexMagic(path, kInt8IndexMagic);
+}
+
+// Function to write int8 codes to disk
+inline bool saveInt8Index(const Int8Index& index, const std::string& path) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Error: Unable to open int8 index " << path << " for writing." << std::endl;
+        return false;
+    }
+    writeIndexHeader(out, kInt8IndexMagic, kInt8IndexVersion, index.dimension);
+    out.write(reinterpret_cast<const char*>(&index.rowCount), sizeof(index.rowCount));
+    out.write(reinterpret_cast<const char*>(&index.storeFingerprint), sizeof(index.storeFingerprint));
+    out.write(reinterpret_cast<const char*>(index.scales.data()), index.scales.size() * sizeof(float));
+    out.write(reinterpret_cast<const char*>(index.codes.data()), index.codes.size());
+    out.close();
+    if (!out) {
+        std::cerr << "Error: Failed while writing int8 index " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Function to read int8 codes from disk
+inline bool loadInt8Index(const std::string& path, Int8Index& index) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "Error: Unable to open int8 index " << path << std::endl;
+        return false;
+    }
+    if (!readIndexHeader(in, path, "int8", kInt8IndexMagic, kInt8IndexVersion, index.dimension)) {
+        return false;
+    }
+    in.read(reinterpret_cast<char*>(&index.rowCount), sizeof(index.rowCount));
+    in.read(reinterpret_cast<char*>(&index.storeFingerprint), sizeof(index.storeFingerprint));
+    uint64_t left = bytesLeft(in);
+    if (!in || index.dimension == 0 || index.dimension > left / sizeof(float) || index.rowCount > left / index.dimension) {
+        std::cerr << "Error: int8 index " << path << " has an invalid header." << std::endl;
+        return false;
+    }
+    index.scales.resize(index.dimension);
+    index.codes.resize(index.rowCount * index.dimension);
+    in.read(reinterpret_cast<char*>(index.scales.data()), index.scales.size() * sizeof(float));
+    in.read(reinterpret_cast<char*>(index.codes.data()), index.codes.size());
+    if (!in) {
+        std::cerr << "Error: int8 index " << path << " is truncated." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+#endif // INT8_INDEX_H
@@ -0,0 +1,263 @@
+/*
+
+Authored by: Aadhi Aadhavan Balasubramanian, Harishraj Udaya Bhaskar
+Date: 10/17/2026
+
+*/
+
+#ifndef IVF_INDEX_H
+#define IVF_INDEX_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "dotKernels.h"
+#include "approximateIndex.h"
+#include "parallelScan.h"
+#include "topN.h"
+
+// Inverted-file (IVF) index over the rows of an embedding store. A spherical
+// k-means quantizer splits the unit sphere into listCount cells; every row
+// is filed under its closest centroid. A query ranks the centroids and only
+// scans the rows of its nprobe closest cells, so its cost is about
+// nprobe / listCount of an exhaustive scan. The index only holds row
+// numbers, the vectors are read from the store it was built from.
+//
+// File layout (native byte order):
+//   char[8]  magic "CBIRIVF1"
+//   uint32   format version
+//   uint32   dimension
+//   uint32   list count
+//   uint64   row count of the store
+//   uint64   fingerprint of the store (embeddingStoreFingerprint)
+//   float    centroids[listCount][dimension]   (unit length)
+//   uint64   listOffsets[listCount + 1]
+//   uint32   rows[rowCount]                    (grouped by list)
+struct IvfIndex {
+    uint32_t dimension = 0;
+    uint32_t listCount = 0;
+    uint64_t rowCount = 0;
+    uint64_t storeFingerprint = 0;
+    std::vector<float> centroids;
+    std::vector<uint64_t> listOffsets;
+    std::vector<uint32_t> rows;
+};
+
+static const char kIvfIndexMagic[8] = { 'C', 'B', 'I', 'R', 'I', 'V', 'F', '1' };
+static const uint32_t kIvfIndexVersion = 2;
+
+namespace ivf_index_detail {
+
+// Rows assigned per matrix product while training and filing
+const size_t kAssignBlockRows = 64;
+
+// Function to find the closest centroid of every row: rows are compared by
+// dot product, which picks the same centroid whatever a row's length
+inline void assignRows(const float* rows, size_t count, size_t dimension, const std::vector<float>& centroids,
+                       size_t listCount, ThreadPool& pool, std::vector<uint32_t>& assignment) {
+    assignment.resize(count);
+    size_t blocks = (count + kAssignBlockRows - 1) / kAssignBlockRows;
+    parallelFor(pool, blocks, [&](size_t block) {
+        size_t first = block * kAssignBlockRows;
+        size_t blockRows = std::min(kAssignBlockRows, count - first);
+        std::vector<float> similarities(blockRows * listCount);
+        matrixProductTransposed(rows + first * dimension, blockRows, centroids.data(), listCount, dimension, similarities.data());
+        for (size_t r = 0; r < blockRows; ++r) {
+            const float* similarity = similarities.data() + r * listCount;
+            assignment[first + r] = static_cast<uint32_t>(std::max_element(similarity, similarity + listCount) - similarity);
+        }
+    }, 1);
+}
+
+} // namespace ivf_index_detail
+
+// Function to train the coarse quantizer with spherical k-means on a sample
+// of at most 64 rows per list; centroids are kept at unit length
+inline std::vector<float> trainIvfCentroids(const float* rows, size_t count, size_t dimension, size_t listCount,
+                                            ThreadPool& pool, int iterations = 10) {
+    using namespace ivf_index_detail;
+    std::mt19937 random(12345);
+    std::vector<size_t> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), random);
+    size_t sampleCount = std::min(count, listCount * 64);
+    if (sampleCount == 0) {
+        return std::vector<float>(listCount * dimension, 0.0f);
+    }
+
+    // The sample is copied at unit length so every row pulls its centroid equally
+    std::vector<float> sample(sampleCount * dimension);
+    for (size_t i = 0; i < sampleCount; ++i) {
+        normalizeVector(rows + order[i] * dimension, sample.data() + i * dimension, dimension);
+    }
+    std::vector<float> centroids(sample.begin(), sample.begin() + listCount * dimension);
+
+    std::vector<uint32_t> assignment;
+    for (int iteration = 0; iteration < iterations; ++iteration) {
+        assignRows(sample.data(), sampleCount, dimension, centroids, listCount, pool, assignment);
+
+        std::vector<double> sums(listCount * dimension, 0.0);
+        std::vector<size_t> sizes(listCount, 0);
+        for (size_t i = 0; i < sampleCount; ++i) {
+            double* sum = sums.data() + assignment[i] * dimension;
+            const float* row = sample.data() + i * dimension;
+            for (size_t k = 0; k < dimension; ++k) {
+                sum[k] += row[k];
+            }
+            ++sizes[assignment[i]];
+        }
+
+        // Empty cells restart from a random sample row
+        std::uniform_int_distribution<size_t> pick(0, sampleCount - 1);
+        for (size_t list = 0; list < listCount; ++list) {
+            float* centroid = centroids.data() + list * dimension;
+            if (sizes[list] == 0) {
+                std::memcpy(centroid, sample.data() + pick(random) * dimension, dimension * sizeof(float));
+                continue;
+            }
+            std::vector<float> mean(sums.begin() + list * dimension, sums.begin() + (list + 1) * dimension);
+            normalizeVector(mean.data(), centroid, dimension);
+        }
+    }
+    return centroids;
+}
+
+// Function to build an IVF index over count rows with listCount cells; false
+// when the store has more rows than a uint32 row id can name
+inline bool buildIvfIndex(const float* rows, size_t count, size_t dimension, size_t listCount, ThreadPool& pool, IvfIndex& index) {
+    if (count > UINT32_MAX) {
+        std::cerr << "Error: An IVF index holds at most " << UINT32_MAX << " rows, the store has " << count << "." << std::endl;
+        return false;
+    }
+    listCount = std::max<size_t>(1, std::min(listCount, count));
+    index.dimension = static_cast<uint32_t>(dimension);
+    index.listCount = static_cast<uint32_t>(listCount);
+    index.rowCount = count;
+    index.centroids.assign(listCount * dimension, 0.0f);
+    index.listOffsets.assign(listCount + 1, 0);
+    index.rows.clear();
+    if (count == 0) {
+        return true;
+    }
+    index.centroids = trainIvfCentroids(rows, count, dimension, listCount, pool);
+
+    // File every row under its closest centroid, keeping store order within a list
+    std::vector<uint32_t> assignment;
+    ivf_index_detail::assignRows(rows, count, dimension, index.centroids, listCount, pool, assignment);
+    for (uint32_t list : assignment) {
+        ++index.listOffsets[list + 1];
+    }
+    std::partial_sum(index.listOffsets.begin(), index.listOffsets.end(), index.listOffsets.begin());
+    std::vector<uint64_t> cursor(index.listOffsets.begin(), index.listOffsets.end() - 1);
+    index.rows.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        index.rows[cursor[assignment[i]]++] = static_cast<uint32_t>(i);
+    }
+    return true;
+}
+
+// Function to rank the rows of the nprobe cells closest to a unit-length
+// query, closest first. rowsNormalized tells whether the store rows have
+// unit length; otherwise their lengths are divided out.
+inline std::vector<TopN<size_t>::Entry> searchIvfIndex(const IvfIndex& index, const float* rows, bool rowsNormalized,
+                                                       const float* unitQuery, int N, size_t nprobe) {
+    size_t dimension = index.dimension;
+    std::vector<float> similarities(index.listCount);
+    matrixVectorProduct(index.centroids.data(), index.listCount, dimension, unitQuery, similarities.data());
+    nprobe = std::max<size_t>(1, std::min<size_t>(nprobe, index.listCount));
+    std::vector<uint32_t> lists(index.listCount);
+    std::iota(lists.begin(), lists.end(), 0);
+    std::partial_sort(lists.begin(), lists.begin() + nprobe, lists.end(),
+                      [&](uint32_t a, uint32_t b) { return similarities[a] > similarities[b]; });
+
+    TopN<size_t> best(N);
+    for (size_t p = 0; p < nprobe; ++p) {
+        for (uint64_t i = index.listOffsets[lists[p]]; i < index.listOffsets[lists[p] + 1]; ++i) {
+            const float* row = rows + static_cast<size_t>(index.rows[i]) * dimension;
+            best.push(rowCosineDistance(row, unitQuery, dimension, rowsNormalized), index.rows[i]);
+        }
+    }
+    return best.sorted();
+}
+
+// Function to check whether a file starts with the IVF index magic
+inline bool isIvfIndexFile(const std::string& path) {
+    return hasIndexMagic(path, kIvfIndexMagic);
+}
+
+// Function to write an IVF index to disk
+inline bool saveIvfIndex(const IvfIndex& index, const std::string& path) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Error: Unable to open IVF index " << path << " for writing." << std::endl;
+        return false;
+    }
+    writeIndexHeader(out, kIvfIndexMagic, kIvfIndexVersion, index.dimension);
+    out.write(reinterpret_cast<const char*>(&index.listCount), sizeof(index.listCount));
+    out.write(reinterpret_cast<const char*>(&index.rowCount), sizeof(index.rowCount));
+    out.write(reinterpret_cast<const char*>(&index.storeFingerprint), sizeof(index.storeFingerprint));
+    out.write(reinterpret_cast<const char*>(index.centroids.data()), index.centroids.size() * sizeof(float));
+    out.write(reinterpret_cast<const char*>(index.listOffsets.data()), index.listOffsets.size() * sizeof(uint64_t));
+    out.write(reinterpret_cast<const char*>(index.rows.data()), index.rows.size() * sizeof(uint32_t));
+    out.close();
+    if (!out) {
+        std::cerr << "Error: Failed while writing IVF index " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Function to read an IVF index from disk
+inline bool loadIvfIndex(const std::string& path, IvfIndex& index) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "Error: Unable to open IVF index " << path << std::endl;
+        return false;
+    }
+    if (!readIndexHeader(in, path, "IVF", kIvfIndexMagic, kIvfIndexVersion, index.dimension)) {
+        return false;
+    }
+    in.read(reinterpret_cast<char*>(&index.listCount), sizeof(index.listCount));
+    in.read(reinterpret_cast<char*>(&index.rowCount), sizeof(index.rowCount));
+    in.read(reinterpret_cast<char*>(&index.storeFingerprint), sizeof(index.storeFingerprint));
+    uint64_t left = bytesLeft(in);
+    if (!in || index.dimension == 0 || index.listCount == 0 || index.rowCount > UINT32_MAX || index.rowCount > left / sizeof(uint32_t) ||
+        index.listCount > left / (index.dimension * sizeof(float) + sizeof(uint64_t))) {
+        std::cerr << "Error: IVF index " << path << " has an invalid header." << std::endl;
+        return false;
+    }
+    index.centroids.resize(static_cast<size_t>(index.listCount) * index.dimension);
+    index.listOffsets.resize(static_cast<size_t>(index.listCount) + 1);
+    index.rows.resize(index.rowCount);
+    in.read(reinterpret_cast<char*>(index.centroids.data()), index.centroids.size() * sizeof(float));
+    in.read(reinterpret_cast<char*>(index.listOffsets.data()), index.listOffsets.size() * sizeof(uint64_t));
+    in.read(reinterpret_cast<char*>(index.rows.data()), index.rows.size() * sizeof(uint32_t));
+    if (!in || index.listOffsets.back() != index.rowCount) {
+        std::cerr << "Error: IVF index " << path << " is truncated." << std::endl;
+        return false;
+    }
+
+    // Every list must lie inside the row array and every row must be a row of the store
+    bool valid = index.listOffsets[0] == 0;
+    for (size_t list = 0; valid && list < index.listCount; ++list) {
+        valid = index.listOffsets[list] <= index.listOffsets[list + 1];
+    }
+    for (size_t i = 0; valid && i < index.rows.size(); ++i) {
+        valid = index.rows[i] < index.rowCount;
+    }
+    if (!valid) {
+        std::cerr << "Error: IVF index " << path << " holds rows outside its store." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+#endif // IVF_INDEX_H
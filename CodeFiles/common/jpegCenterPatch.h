@@ -0,0 +1,162 @@
+/*
+
+Authored by: Aadhi Aadhavan Balasubramanian, Harishraj Udaya Bhaskar
+Date: 10/17/2026
+
+*/
+
+#ifndef JPEG_CENTER_PATCH_H
+#define JPEG_CENTER_PATCH_H
+
+#include <algorithm>
+#include <csetjmp>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#ifdef CBIR_HAVE_JPEG
+#include <jpeglib.h>
+#endif
+
+// Decodes only the middle of a JPEG. libjpeg-turbo can crop each scanline to
+// the iMCU columns that cover a region (jpeg_crop_scanline) and skip whole
+// rows without colour conversion or upsampling (jpeg_skip_scanlines). A
+// centre patch of a large photo then costs a few MCU rows of Huffman decoding
+// instead of a full decode. The pixels are the ones a full decode gives,
+// in OpenCV's BGR order.
+//
+// Anything that imread would treat differently is refused: non-JPEG data,
+// files with an EXIF orientation (imread rotates those), colour spaces
+// libjpeg cannot convert to BGR, images smaller than the patch, and corrupt
+// data. Callers fall back to a full decode for those. Without libjpeg
+// (CBIR_HAVE_JPEG unset) every image is refused.
+#ifdef CBIR_HAVE_JPEG
+namespace jpeg_center_patch_detail {
+
+// A crop starts on an iMCU boundary, at most 32 pixels (4x horizontal
+// subsampling of 8-pixel blocks) left of the patch. It is also asked for
+// that much past the patch on the right: fancy upsampling treats the last
+// column of a crop as the image edge, which would change the patch's last
+// pixels.
+const int kMaxCropSlack = 32;
+
+// Error manager that jumps back to the decoder instead of calling exit()
+struct ErrorManager {
+    jpeg_error_mgr base;
+    jmp_buf escape;
+};
+
+inline void raiseError(j_common_ptr info) {
+    longjmp(reinterpret_cast<ErrorManager*>(info->err)->escape, 1);
+}
+
+inline void ignoreMessage(j_common_ptr, int) {
+}
+
+inline uint16_t readUint16(const uint8_t* p, bool bigEndian) {
+    return bigEndian ? static_cast<uint16_t>(p[0] << 8 | p[1]) : static_cast<uint16_t>(p[1] << 8 | p[0]);
+}
+
+inline uint32_t readUint32(const uint8_t* p, bool bigEndian) {
+    return bigEndian ? (uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3])
+                     : (uint32_t(p[3]) << 24 | uint32_t(p[2]) << 16 | uint32_t(p[1]) << 8 | p[0]);
+}
+
+// Function to read the orientation tag from IFD0 of an EXIF APP1 block; 1 when absent
+inline int exifOrientation(const jpeg_saved_marker_ptr markers) {
+    for (jpeg_saved_marker_ptr marker = markers; marker != nullptr; marker = marker->next) {
+        const uint8_t* data = marker->data;
+        size_t size = marker->data_length;
+        if (marker->marker != JPEG_APP0 + 1 || size < 14 || std::memcmp(data, "Exif\0\0", 6) != 0) {
+            continue;
+        }
+        const uint8_t* tiff = data + 6;
+        size_t tiffSize = size - 6;
+        bool bigEndian = tiff[0] == 'M';
+        uint32_t ifd = readUint32(tiff + 4, bigEndian);
+        if (ifd > tiffSize - 2) {
+            return 1;
+        }
+        uint16_t entries = readUint16(tiff + ifd, bigEndian);
+        for (uint16_t e = 0; e < entries && ifd + 2 + (e + 1) * 12u <= tiffSize; ++e) {
+            const uint8_t* entry = tiff + ifd + 2 + e * 12;
+            if (readUint16(entry, bigEndian) == 0x0112) {
+                return readUint16(entry + 8, bigEndian);
+            }
+        }
+        return 1;
+    }
+    return 1;
+}
+
+} // namespace jpeg_center_patch_detail
+#endif // CBIR_HAVE_JPEG
+
+// Function to decode the size x size patch at the centre of a JPEG held in
+// memory, at the position computeFeatures would crop it from a full decode.
+// Returns false, with patch untouched, when the caller should decode the whole image instead.
+inline bool decodeJpegCenterPatch(const unsigned char* data, size_t length, int size, cv::Mat& patch) {
+#if defined(CBIR_HAVE_JPEG) && defined(LIBJPEG_TURBO_VERSION) && defined(JCS_EXTENSIONS)
+    using namespace jpeg_center_patch_detail;
+    if (length < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+        return false;
+    }
+
+    // Everything the decoder writes after setjmp goes through pointers into
+    // memory set up before it, so a longjmp leaves nothing half-constructed
+    std::vector<unsigned char> rows(static_cast<size_t>(size) * (size + 2 * kMaxCropSlack) * 3);
+    jpeg_decompress_struct info;
+    ErrorManager errors;
+    info.err = jpeg_std_error(&errors.base);
+    errors.base.error_exit = raiseError;
+    errors.base.emit_message = ignoreMessage;
+    if (setjmp(errors.escape)) {
+        jpeg_destroy_decompress(&info);
+        return false;
+    }
+    jpeg_create_decompress(&info);
+    jpeg_mem_src(&info, data, static_cast<unsigned long>(length));
+    jpeg_save_markers(&info, JPEG_APP0 + 1, 0xFFFF);
+    if (jpeg_read_header(&info, TRUE) != JPEG_HEADER_OK || exifOrientation(info.marker_list) != 1 ||
+        static_cast<int>(info.image_width) < size || static_cast<int>(info.image_height) < size) {
+        jpeg_destroy_decompress(&info);
+        return false;
+    }
+    info.out_color_space = JCS_EXT_BGR;
+    jpeg_start_decompress(&info);
+
+    // The crop widens to whole iMCU columns, so remember where the patch sits inside it
+    JDIMENSION x = (info.output_width - size) / 2;
+    JDIMENSION y = (info.output_height - size) / 2;
+    JDIMENSION cropX = x, cropWidth = std::min<JDIMENSION>(size + kMaxCropSlack, info.output_width - x);
+    jpeg_crop_scanline(&info, &cropX, &cropWidth);
+    if (info.output_width > static_cast<JDIMENSION>(size + 2 * kMaxCropSlack) || jpeg_skip_scanlines(&info, y) != y) {
+        jpeg_destroy_decompress(&info);
+        return false;
+    }
+    int width = static_cast<int>(info.output_width);
+    for (int row = 0; row < size; ++row) {
+        JSAMPROW line = rows.data() + static_cast<size_t>(row) * width * 3;
+        if (jpeg_read_scanlines(&info, &line, 1) != 1) {
+            jpeg_destroy_decompress(&info);
+            return false;
+        }
+    }
+    jpeg_abort_decompress(&info);
+    jpeg_destroy_decompress(&info);
+    patch = cv::Mat(size, width, CV_8UC3, rows.data())(cv::Rect(static_cast<int>(x - cropX), 0, size, size)).clone();
+    return true;
+#else
+    (void)data;
+    (void)length;
+    (void)size;
+    (void)patch;
+    return false;
+#endif
+}
+
+#endif // JPEG_CENTER_PATCH_H
@@ -0,0 +1,136 @@
+/*
+
+Authored by: Aadhi Aadhavan Balasubramanian, Harishraj Udaya Bhaskar
+Date: 10/17/2026
+
+*/
+
+#ifndef PARALLEL_SCAN_H
+#define PARALLEL_SCAN_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that all run the same task. The query binaries
+// use it to spread the per-image work of a database scan over every core.
+class ThreadPool {
+public:
+    explicit ThreadPool(int threads) {
+        int count = std::max(1, threads);
+        for (int worker = 0; worker < count; ++worker) {
+            workers_.emplace_back([this, worker] { workerLoop(worker); });
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (std::thread& thread : workers_) {
+            thread.join();
+        }
+    }
+
+    int size() const { return static_cast<int>(workers_.size()); }
+
+    // Function to run task(worker) once on every worker and wait for all of them
+    void run(const std::function<void(int)>& task) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        task_ = &task;
+        remaining_ = workers_.size();
+        ++generation_;
+        wake_.notify_all();
+        done_.wait(lock, [this] { return remaining_ == 0; });
+        task_ = nullptr;
+    }
+
+private:
+    void workerLoop(int worker) {
+        size_t seen = 0;
+        while (true) {
+            const std::function<void(int)>* task = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+                if (stopping_) {
+                    return;
+                }
+                seen = generation_;
+                task = task_;
+            }
+            (*task)(worker);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (--remaining_ == 0) {
+                    done_.notify_one();
+                }
+            }
+        }
+    }
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void(int)>* task_ = nullptr;
+    size_t generation_ = 0;
+    size_t remaining_ = 0;
+    bool stopping_ = false;
+};
+
+// Function to call visit(i) for every i in [0, count) on the pool. Items are
+// handed out in small batches from a shared counter, so a few slow decodes
+// do not leave the other workers idle.
+template <typename Visit>
+void parallelFor(ThreadPool& pool, size_t count, Visit visit, size_t batch = 8) {
+    std::atomic<size_t> next(0);
+    pool.run([&](int) {
+        while (true) {
+            size_t begin = next.fetch_add(batch);
+            if (begin >= count) {
+                return;
+            }
+            size_t end = std::min(count, begin + batch);
+            for (size_t i = begin; i < end; ++i) {
+                visit(i);
+            }
+        }
+    });
+}
+
+// Function to scan [0, count) on the pool with one partial result per worker,
+// each starting as a copy of initial. visit(i, partial) accumulates into the
+// worker's own partial, so no locking is needed; the partials are returned
+// for the caller to merge.
+template <typename Partial, typename Visit>
+std::vector<Partial> parallelScan(ThreadPool& pool, size_t count, const Partial& initial, Visit visit, size_t batch = 8) {
+    std::vector<Partial> partials(pool.size(), initial);
+    std::atomic<size_t> next(0);
+    pool.run([&](int worker) {
+        Partial& partial = partials[worker];
+        while (true) {
+            size_t begin = next.fetch_add(batch);
+            if (begin >= count) {
+                return;
+            }
+            size_t end = std::min(count, begin + batch);
+            for (size_t i = begin; i < end; ++i) {
+                visit(i, partial);
+            }
+        }
+    });
+    return partials;
+}
+
+#endif // PARALLEL_SCAN_H
@@ -0,0 +1,191 @@
+/*
+
+Authored by: Aadhi Aadhavan Balasubramanian, Harishraj Udaya Bhaskar
+Date: 10/17/2026
+
+*/
+
+#ifndef PATCH_MATRIX_H
+#define PATCH_MATRIX_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "dotKernels.h"
+
+// Small 8-bit image patches (Question1's 7x7 BGR centers) packed into one
+// matrix, so a scan scores thousands of them per call without any per-patch
+// allocation. Each row is padded with zeros to a whole number of 32-byte
+// registers, and the matrix starts on a 64-byte boundary, so every row starts
+// on a register boundary and no row needs a scalar tail. A query padded the
+// same way adds nothing for the padding bytes.
+class PatchMatrix {
+public:
+    static const size_t kAlignment = 64;
+    static const size_t kRowAlignment = 32;
+
+    size_t rows() const { return rows_; }
+    size_t dimension() const { return dimension_; }
+    size_t stride() const { return stride_; }
+
+    const uint8_t* row(size_t r) const { return storage_.data() + offset_ + r * stride_; }
+    uint8_t* row(size_t r) { return storage_.data() + offset_ + r * stride_; }
+
+    // Function to size the matrix for rows patches of dimension bytes, all zero
+    void reset(size_t rows, size_t dimension) {
+        rows_ = rows;
+        dimension_ = dimension;
+        stride_ = (dimension + kRowAlignment - 1) / kRowAlignment * kRowAlignment;
+        storage_.assign(rows * stride_ + kAlignment, 0);
+        offset_ = (kAlignment - reinterpret_cast<uintptr_t>(storage_.data()) % kAlignment) % kAlignment;
+    }
+
+private:
+    size_t rows_ = 0;
+    size_t dimension_ = 0;
+    size_t stride_ = 0;
+    size_t offset_ = 0;
+    std::vector<uint8_t> storage_;
+};
+
+namespace patch_matrix_detail {
+
+inline uint32_t scalarSsd(const uint8_t* a, const uint8_t* b, size_t n) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+        int32_t diff = static_cast<int32_t>(a[i]) - b[i];
+        sum += static_cast<uint32_t>(diff * diff);
+    }
+    return sum;
+}
+
+inline void scalarSsdRows(const uint8_t* rows, size_t count, size_t stride, const uint8_t* query, size_t length, uint32_t* out) {
+    for (size_t r = 0; r < count; ++r) {
+        out[r] = scalarSsd(rows + r * stride, query, length);
+    }
+}
+
+#ifdef CBIR_X86_KERNELS
+
+// Function to add the squared differences of 32 byte pairs to acc. |a - b|
+// is taken in 8 bits with two saturating subtractions, then widened to 16
+// bits so vpmaddwd squares and pairs it. vpmaddubsw cannot square it: one
+// operand must be signed, and 255 * 255 does not fit either way.
+__attribute__((target("avx2"))) inline __m256i avx2SsdStep(__m256i acc, __m256i a, __m256i b) {
+    __m256i difference = _mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a));
+    __m256i low = _mm256_unpacklo_epi8(difference, _mm256_setzero_si256());
+    __m256i high = _mm256_unpackhi_epi8(difference, _mm256_setzero_si256());
+    acc = _mm256_add_epi32(acc, _mm256_madd_epi16(low, low));
+    return _mm256_add_epi32(acc, _mm256_madd_epi16(high, high));
+}
+
+// Four rows at a time share every query load, and their sums are reduced
+// together with two rounds of horizontal adds
+__attribute__((target("avx2"))) inline void avx2SsdRows(const uint8_t* rows, size_t count, size_t stride, const uint8_t* query, size_t length, uint32_t* out) {
+    size_t whole = length / 32 * 32;
+    size_t r = 0;
+    for (; r + 4 <= count; r += 4) {
+        const uint8_t* row0 = rows + r * stride;
+        const uint8_t* row1 = row0 + stride;
+        const uint8_t* row2 = row1 + stride;
+        const uint8_t* row3 = row2 + stride;
+        __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+        __m256i acc2 = _mm256_setzero_si256(), acc3 = _mm256_setzero_si256();
+        for (size_t i = 0; i < whole; i += 32) {
+            __m256i q = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(query + i));
+            acc0 = avx2SsdStep(acc0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0 + i)), q);
+            acc1 = avx2SsdStep(acc1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1 + i)), q);
+            acc2 = avx2SsdStep(acc2, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row2 + i)), q);
+            acc3 = avx2SsdStep(acc3, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row3 + i)), q);
+        }
+        __m256i sums = _mm256_hadd_epi32(_mm256_hadd_epi32(acc0, acc1), _mm256_hadd_epi32(acc2, acc3));
+        __m128i total = _mm_add_epi32(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + r), total);
+        if (whole < length) {
+            out[r] += scalarSsd(row0 + whole, query + whole, length - whole);
+            out[r + 1] += scalarSsd(row1 + whole, query + whole, length - whole);
+            out[r + 2] += scalarSsd(row2 + whole, query + whole, length - whole);
+            out[r + 3] += scalarSsd(row3 + whole, query + whole, length - whole);
+        }
+    }
+    for (; r < count; ++r) {
+        const uint8_t* row = rows + r * stride;
+        __m256i acc = _mm256_setzero_si256();
+        for (size_t i = 0; i < whole; i += 32) {
+            acc = avx2SsdStep(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i)),
+                              _mm256_loadu_si256(reinterpret_cast<const __m256i*>(query + i)));
+        }
+        out[r] = static_cast<uint32_t>(dot_kernels_detail::avx2SumInt(acc)) + scalarSsd(row + whole, query + whole, length - whole);
+    }
+}
+
+#endif // CBIR_X86_KERNELS
+
+typedef void (*SsdRowsKernel)(const uint8_t*, size_t, size_t, const uint8_t*, size_t, uint32_t*);
+
+// Function to pick the SSD kernel for the running CPU
+inline SsdRowsKernel selectSsdRowsKernel() {
+#ifdef CBIR_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return avx2SsdRows;
+    }
+#endif
+    return scalarSsdRows;
+}
+
+// Function to compute out[r] = sum over [0, length) of (rows[r * stride + i] - query[i])^2
+inline void squaredDifferenceRows(const uint8_t* rows, size_t count, size_t stride, const uint8_t* query, size_t length, uint32_t* out) {
+    static const SsdRowsKernel kernel = selectSsdRowsKernel();
+    kernel(rows, count, stride, query, length, out);
+}
+
+} // namespace patch_matrix_detail
+
+// Function to compute the sum of squared differences of two byte vectors
+inline uint32_t patchSquaredDistance(const uint8_t* a, const uint8_t* b, size_t n) {
+    uint32_t distance = 0;
+    patch_matrix_detail::squaredDifferenceRows(a, 1, n, b, n, &distance);
+    return distance;
+}
+
+// Function to score patches [first, first + count) of a matrix against a
+// query laid out like one of its rows (see padPatchQuery)
+inline void patchSquaredDistances(const PatchMatrix& patches, size_t first, size_t count, const uint8_t* query, uint32_t* out) {
+    patch_matrix_detail::squaredDifferenceRows(patches.row(first), count, patches.stride(), query, patches.stride(), out);
+}
+
+// Function to copy a patch into a zero-padded buffer one matrix row long
+inline std::vector<uint8_t> padPatchQuery(const PatchMatrix& patches, const uint8_t* patch) {
+    std::vector<uint8_t> query(patches.stride(), 0);
+    std::copy(patch, patch + patches.dimension(), query.begin());
+    return query;
+}
+
+// Function to copy rows [first, first + count) of a packed count x dimension
+// byte array, as feature indexes store patches, into the same matrix rows
+inline void copyPatchRows(const uint8_t* rows, size_t first, size_t count, PatchMatrix& patches) {
+    size_t dimension = patches.dimension();
+    for (size_t r = first; r < first + count; ++r) {
+        std::memcpy(patches.row(r), rows + r * dimension, dimension);
+    }
+}
+
+// Function to fill rows [first, first + count) from float rows holding whole
+// byte values, as feature indexes before version 3 stored patches
+inline void fillPatchRows(const float* rows, size_t first, size_t count, PatchMatrix& patches) {
+    size_t dimension = patches.dimension();
+    for (size_t r = first; r < first + count; ++r) {
+        const float* source = rows + r * dimension;
+        uint8_t* row = patches.row(r);
+        for (size_t k = 0; k < dimension; ++k) {
+            row[k] = static_cast<uint8_t>(std::max(0.0f, std::min(255.0f, std::round(source[k]))));
+        }
+    }
+}
+
+#endif // PATCH_MATRIX_H
@@ -0,0 +1,477 @@
+/*
+
+Authored by: Aadhi Aadhavan Balasubramanian, Harishraj Udaya Bhaskar
+Date: 10/17/2026
+
+*/
+
+#ifndef PCA_INDEX_H
+#define PCA_INDEX_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "dotKernels.h"
+#include "approximateIndex.h"
+#include "parallelScan.h"
+#include "topN.h"
+
+// PCA-reduced copy of the rows of an embedding store. The principal axes of
+// the unit-length rows are trained offline, and every row is projected onto
+// the top `dimension` of them. Rows are ranked by half the squared distance
+// between projections: for unit-length rows that is the cosine distance, so
+// with every axis kept the ranking is the exact one. A scan then reads
+// dimension / sourceDimension of the floats. Whitening divides each axis by
+// its standard deviation, so the weak axes count as much as the strong ones;
+// whitened distances are no longer cosine distances. The projection is stored
+// next to the rows. A query from the full store is projected the same way at
+// search time, and the top candidates can be re-ranked exactly against the
+// full rows.
+//
+// File layout (native byte order):
+//   char[8]  magic "CBIRPCA1"
+//   uint32   format version
+//   uint32   source dimension
+//   uint32   reduced dimension
+//   uint32   whitened (1 or 0)
+//   float    share of the variance retained
+//   uint32   reserved
+//   uint64   row count of the store
+//   uint64   fingerprint of the store (embeddingStoreFingerprint)
+//   float    mean[sourceDimension]
+//   float    components[dimension][sourceDimension]   (whitening folded in)
+//   float    rows[rowCount][dimension]
+struct PcaIndex {
+    uint32_t sourceDimension = 0;
+    uint32_t dimension = 0;
+    uint32_t whitened = 0;
+    float retainedVariance = 0.0f;
+    uint64_t rowCount = 0;
+    uint64_t storeFingerprint = 0;
+    std::vector<float> mean;
+    std::vector<float> components;
+    std::vector<float> rows;
+    std::vector<float> halfSquaredNorms;  // |row|^2 / 2 of every reduced row, computed when built or loaded
+
+    const float* row(size_t i) const { return rows.data() + i * dimension; }
+};
+
+static const char kPcaIndexMagic[8] = { 'C', 'B', 'I', 'R', 'P', 'C', 'A', '1' };
+static const uint32_t kPcaIndexVersion = 3;
+
+namespace pca_index_detail {
+
+// Rows sampled to estimate the covariance, rows per covariance product, and
+// rows projected or scanned per task
+const size_t kTrainingRows = 65536;
+const size_t kCovarianceChunkRows = 256;
+const size_t kProjectBlockRows = 256;
+const size_t kScanBlockRows = 1024;
+
+// Function to diagonalize a symmetric n x n matrix held row-major in vectors:
+// on return values holds the eigenvalues and column j of vectors the unit
+// eigenvector of values[j]. Householder reduction to tridiagonal form, then
+// implicit QL iterations (the tred2 / tql2 pair from EISPACK, via JAMA).
+inline void symmetricEigen(size_t n, std::vector<double>& vectors, std::vector<double>& values) {
+    std::vector<double>& V = vectors;
+    std::vector<double>& d = values;
+    std::vector<double> e(n, 0.0);
+    d.assign(n, 0.0);
+    auto at = [&](size_t i, size_t j) -> double& { return V[i * n + j]; };
+
+    // Householder reduction to tridiagonal form
+    for (size_t j = 0; j < n; ++j) {
+        d[j] = at(n - 1, j);
+    }
+    for (size_t i = n - 1; i > 0; --i) {
+        double scale = 0.0, h = 0.0;
+        for (size_t k = 0; k < i; ++k) {
+            scale += std::fabs(d[k]);
+        }
+        if (scale == 0.0) {
+            e[i] = d[i - 1];
+            for (size_t j = 0; j < i; ++j) {
+                d[j] = at(i - 1, j);
+                at(i, j) = 0.0;
+                at(j, i) = 0.0;
+            }
+        } else {
+            for (size_t k = 0; k < i; ++k) {
+                d[k] /= scale;
+                h += d[k] * d[k];
+            }
+            double f = d[i - 1];
+            double g = f > 0 ? -std::sqrt(h) : std::sqrt(h);
+            e[i] = scale * g;
+            h -= f * g;
+            d[i - 1] = f - g;
+            for (size_t j = 0; j < i; ++j) {
+                e[j] = 0.0;
+            }
+            for (size_t j = 0; j < i; ++j) {
+                f = d[j];
+                at(j, i) = f;
+                g = e[j] + at(j, j) * f;
+                for (size_t k = j + 1; k <= i - 1; ++k) {
+                    g += at(k, j) * d[k];
+                    e[k] += at(k, j) * f;
+                }
+                e[j] = g;
+            }
+            f = 0.0;
+            for (size_t j = 0; j < i; ++j) {
+                e[j] /= h;
+                f += e[j] * d[j];
+            }
+            double hh = f / (h + h);
+            for (size_t j = 0; j < i; ++j) {
+                e[j] -= hh * d[j];
+            }
+            for (size_t j = 0; j < i; ++j) {
+                f = d[j];
+                g = e[j];
+                for (size_t k = j; k <= i - 1; ++k) {
+                    at(k, j) -= (f * e[k] + g * d[k]);
+                }
+                d[j] = at(i - 1, j);
+                at(i, j) = 0.0;
+            }
+        }
+        d[i] = h;
+    }
+
+    // Accumulate the transformations
+    for (size_t i = 0; i + 1 < n; ++i) {
+        at(n - 1, i) = at(i, i);
+        at(i, i) = 1.0;
+        double h = d[i + 1];
+        if (h != 0.0) {
+            for (size_t k = 0; k <= i; ++k) {
+                d[k] = at(k, i + 1) / h;
+            }
+            for (size_t j = 0; j <= i; ++j) {
+                double g = 0.0;
+                for (size_t k = 0; k <= i; ++k) {
+                    g += at(k, i + 1) * at(k, j);
+                }
+                for (size_t k = 0; k <= i; ++k) {
+                    at(k, j) -= g * d[k];
+                }
+            }
+        }
+        for (size_t k = 0; k <= i; ++k) {
+            at(k, i + 1) = 0.0;
+        }
+    }
+    for (size_t j = 0; j < n; ++j) {
+        d[j] = at(n - 1, j);
+        at(n - 1, j) = 0.0;
+    }
+    at(n - 1, n - 1) = 1.0;
+    e[0] = 0.0;
+
+    // Implicit QL iterations on the tridiagonal matrix
+    for (size_t i = 1; i < n; ++i) {
+        e[i - 1] = e[i];
+    }
+    e[n - 1] = 0.0;
+    double f = 0.0, tst1 = 0.0;
+    const double eps = std::pow(2.0, -52.0);
+    for (size_t l = 0; l < n; ++l) {
+        tst1 = std::max(tst1, std::fabs(d[l]) + std::fabs(e[l]));
+        size_t m = l;
+        while (m < n && std::fabs(e[m]) > eps * tst1) {
+            ++m;
+        }
+        if (m > l) {
+            do {
+                double g = d[l];
+                double p = (d[l + 1] - g) / (2.0 * e[l]);
+                double r = std::hypot(p, 1.0);
+                if (p < 0) {
+                    r = -r;
+                }
+                d[l] = e[l] / (p + r);
+                d[l + 1] = e[l] * (p + r);
+                double dl1 = d[l + 1];
+                double h = g - d[l];
+                for (size_t i = l + 2; i < n; ++i) {
+                    d[i] -= h;
+                }
+                f += h;
+
+                p = d[m];
+                double c = 1.0, c2 = c, c3 = c;
+                double el1 = e[l + 1];
+                double s = 0.0, s2 = 0.0;
+                for (size_t i = m; i-- > l;) {
+                    c3 = c2;
+                    c2 = c;
+                    s2 = s;
+                    g = c * e[i];
+                    h = c * p;
+                    r = std::hypot(p, e[i]);
+                    e[i + 1] = s * r;
+                    s = e[i] / r;
+                    c = p / r;
+                    p = c * d[i] - s * g;
+                    d[i + 1] = h + s * (c * g + s * d[i]);
+                    for (size_t k = 0; k < n; ++k) {
+                        h = at(k, i + 1);
+                        at(k, i + 1) = s * at(k, i) + c * h;
+                        at(k, i) = c * at(k, i) - s * h;
+                    }
+                }
+                p = -s * s2 * c3 * el1 * e[l] / dl1;
+                e[l] = s * p;
+                d[l] = c * p;
+            } while (std::fabs(e[l]) > eps * tst1);
+        }
+        d[l] += f;
+        e[l] = 0.0;
+    }
+}
+
+// Function to cache half the squared length of every reduced row for the scans
+inline void computeHalfSquaredNorms(PcaIndex& index) {
+    index.halfSquaredNorms.resize(index.rowCount);
+    for (size_t i = 0; i < index.rowCount; ++i) {
+        index.halfSquaredNorms[i] = 0.5f * dotProduct(index.row(i), index.row(i), index.dimension);
+    }
+}
+
+} // namespace pca_index_detail
+
+// Function to project one source row: subtract the mean and multiply by the
+// components. The projection keeps its length, distances are taken between
+// projections of unit-length rows.
+inline void projectPcaRow(const PcaIndex& index, const float* source, float* out) {
+    std::vector<float> centered(index.sourceDimension);
+    for (size_t k = 0; k < index.sourceDimension; ++k) {
+        centered[k] = source[k] - index.mean[k];
+    }
+    matrixVectorProduct(index.components.data(), index.dimension, index.sourceDimension, centered.data(), out);
+}
+
+// Function to compute half the squared distance between the projected query
+// and the reduced rows [first, first + count). Unwhitened with every axis
+// kept, this is the cosine distance of the unit-length source rows.
+inline void pcaDistances(const PcaIndex& index, size_t first, size_t count, const float* projectedQuery, float* out) {
+    matrixVectorProduct(index.row(first), count, index.dimension, projectedQuery, out);
+    float queryHalfSquaredNorm = 0.5f * dotProduct(projectedQuery, projectedQuery, index.dimension);
+    for (size_t r = 0; r < count; ++r) {
+        out[r] = std::max(0.0f, index.halfSquaredNorms[first + r] + queryHalfSquaredNorm - out[r]);
+    }
+}
+
+// Function to train the projection on a sample of unit-length rows and
+// project every row to dimension components, optionally whitened
+inline void buildPcaIndex(const float* rows, size_t count, size_t sourceDimension, size_t dimension, bool whiten,
+                          ThreadPool& pool, PcaIndex& index) {
+    using namespace pca_index_detail;
+    dimension = std::max<size_t>(1, std::min(dimension, sourceDimension));
+    index.sourceDimension = static_cast<uint32_t>(sourceDimension);
+    index.dimension = static_cast<uint32_t>(dimension);
+    index.whitened = whiten ? 1 : 0;
+    index.rowCount = count;
+    index.mean.assign(sourceDimension, 0.0f);
+    index.components.assign(dimension * sourceDimension, 0.0f);
+    index.rows.assign(count * dimension, 0.0f);
+    if (count == 0) {
+        return;
+    }
+
+    // Sample at unit length, as the store rows are compared by angle
+    std::mt19937 random(12345);
+    std::vector<size_t> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), random);
+    size_t sampleCount = std::min(count, kTrainingRows);
+    std::vector<float> sample(sampleCount * sourceDimension);
+    for (size_t i = 0; i < sampleCount; ++i) {
+        normalizeVector(rows + order[i] * sourceDimension, sample.data() + i * sourceDimension, sourceDimension);
+    }
+    std::vector<double> mean(sourceDimension, 0.0);
+    for (size_t i = 0; i < sampleCount; ++i) {
+        for (size_t k = 0; k < sourceDimension; ++k) {
+            mean[k] += sample[i * sourceDimension + k];
+        }
+    }
+    for (size_t k = 0; k < sourceDimension; ++k) {
+        index.mean[k] = static_cast<float>(mean[k] / sampleCount);
+    }
+
+    // Covariance summed over chunks of centered rows. A chunk is stored column-major,
+    // so its share is one cache-sized product of the chunk with itself.
+    size_t squared = sourceDimension * sourceDimension;
+    size_t chunks = (sampleCount + kCovarianceChunkRows - 1) / kCovarianceChunkRows;
+    std::vector<std::vector<double>> partials = parallelScan(pool, chunks, std::vector<double>(squared, 0.0), [&](size_t chunk, std::vector<double>& sum) {
+        size_t first = chunk * kCovarianceChunkRows;
+        size_t chunkRows = std::min(kCovarianceChunkRows, sampleCount - first);
+        std::vector<float> columns(sourceDimension * chunkRows), product(squared);
+        for (size_t i = 0; i < chunkRows; ++i) {
+            for (size_t k = 0; k < sourceDimension; ++k) {
+                columns[k * chunkRows + i] = sample[(first + i) * sourceDimension + k] - index.mean[k];
+            }
+        }
+        matrixProductTransposed(columns.data(), sourceDimension, columns.data(), sourceDimension, chunkRows, product.data());
+        for (size_t j = 0; j < squared; ++j) {
+            sum[j] += product[j];
+        }
+    }, 1);
+
+    std::vector<double> vectors(squared, 0.0), values;
+    for (const std::vector<double>& partial : partials) {
+        for (size_t j = 0; j < squared; ++j) {
+            vectors[j] += partial[j] / static_cast<double>(sampleCount);
+        }
+    }
+    symmetricEigen(sourceDimension, vectors, values);
+
+    // Keep the axes with the largest variance, strongest first
+    std::vector<size_t> axes(sourceDimension);
+    std::iota(axes.begin(), axes.end(), 0);
+    std::sort(axes.begin(), axes.end(), [&](size_t a, size_t b) { return values[a] > values[b]; });
+    double total = 0.0, kept = 0.0;
+    for (size_t k = 0; k < sourceDimension; ++k) {
+        total += std::max(0.0, values[axes[k]]);
+        if (k < dimension) {
+            kept += std::max(0.0, values[axes[k]]);
+        }
+    }
+    index.retainedVariance = total > 0.0 ? static_cast<float>(kept / total) : 1.0f;
+    for (size_t c = 0; c < dimension; ++c) {
+        double scale = whiten ? 1.0 / std::sqrt(std::max(values[axes[c]], 1e-12)) : 1.0;
+        for (size_t k = 0; k < sourceDimension; ++k) {
+            index.components[c * sourceDimension + k] = static_cast<float>(vectors[k * sourceDimension + axes[c]] * scale);
+        }
+    }
+
+    // Project blocks of centered unit-length rows with one matrix product each
+    size_t blocks = (count + kProjectBlockRows - 1) / kProjectBlockRows;
+    parallelFor(pool, blocks, [&](size_t block) {
+        size_t first = block * kProjectBlockRows;
+        size_t blockRows = std::min(kProjectBlockRows, count - first);
+        std::vector<float> centered(blockRows * sourceDimension);
+        for (size_t i = 0; i < blockRows; ++i) {
+            float* row = centered.data() + i * sourceDimension;
+            normalizeVector(rows + (first + i) * sourceDimension, row, sourceDimension);
+            for (size_t k = 0; k < sourceDimension; ++k) {
+                row[k] -= index.mean[k];
+            }
+        }
+        float* projected = index.rows.data() + first * dimension;
+        matrixProductTransposed(centered.data(), blockRows, index.components.data(), dimension, sourceDimension, projected);
+    }, 1);
+    computeHalfSquaredNorms(index);
+}
+
+// Function to rank the reduced rows by their distance to the projection of a
+// unit-length source query (see pcaDistances), closest first. When rerank is
+// larger than zero, the best max(rerank, N) rows are scored again exactly
+// against the source rows; rowsNormalized tells whether those have unit length.
+inline std::vector<TopN<size_t>::Entry> searchPcaIndex(const PcaIndex& index, const float* rows, bool rowsNormalized,
+                                                       const float* unitQuery, int N, size_t rerank, ThreadPool& pool) {
+    using namespace pca_index_detail;
+    std::vector<float> query(index.dimension);
+    projectPcaRow(index, unitQuery, query.data());
+    int candidates = rerank > 0 ? std::max(N, static_cast<int>(rerank)) : N;
+
+    size_t blocks = (index.rowCount + kScanBlockRows - 1) / kScanBlockRows;
+    std::vector<TopN<size_t>> partials = parallelScan(pool, blocks, TopN<size_t>(candidates), [&](size_t block, TopN<size_t>& best) {
+        thread_local std::vector<float> distances;
+        size_t first = block * kScanBlockRows;
+        size_t blockRows = std::min<size_t>(kScanBlockRows, index.rowCount - first);
+        distances.resize(blockRows);
+        pcaDistances(index, first, blockRows, query.data(), distances.data());
+        for (size_t r = 0; r < blockRows; ++r) {
+            best.push(distances[r], first + r);
+        }
+    }, 1);
+    std::vector<TopN<size_t>::Entry> matches = mergeTopN(partials).sorted();
+    if (rerank == 0) {
+        return matches;
+    }
+
+    return rerankExact(rows, rowsNormalized, unitQuery, index.sourceDimension, matches, N);
+}
+
+// Function to check whether a file starts with the PCA index magic
+inline bool isPcaIndexFile(const std::string& path) {
+    return hasIndexMagic(path, kPcaIndexMagic);
+}
+
+// Function to write a PCA index to disk
+inline bool savePcaIndex(const PcaIndex& index, const std::string& path) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Error: Unable to open PCA index " << path << " for writing." << std::endl;
+        return false;
+    }
+    uint32_t reserved = 0;
+    writeIndexHeader(out, kPcaIndexMagic, kPcaIndexVersion, index.sourceDimension);
+    out.write(reinterpret_cast<const char*>(&index.dimension), sizeof(index.dimension));
+    out.write(reinterpret_cast<const char*>(&index.whitened), sizeof(index.whitened));
+    out.write(reinterpret_cast<const char*>(&index.retainedVariance), sizeof(index.retainedVariance));
+    out.write(reinterpret_cast<const char*>(&reserved), sizeof(reserved));
+    out.write(reinterpret_cast<const char*>(&index.rowCount), sizeof(index.rowCount));
+    out.write(reinterpret_cast<const char*>(&index.storeFingerprint), sizeof(index.storeFingerprint));
+    out.write(reinterpret_cast<const char*>(index.mean.data()), index.mean.size() * sizeof(float));
+    out.write(reinterpret_cast<const char*>(index.components.data()), index.components.size() * sizeof(float));
+    out.write(reinterpret_cast<const char*>(index.rows.data()), index.rows.size() * sizeof(float));
+    out.close();
+    if (!out) {
+        std::cerr << "Error: Failed while writing PCA index " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Function to read a PCA index from disk
+inline bool loadPcaIndex(const std::string& path, PcaIndex& index) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "Error: Unable to open PCA index " << path << std::endl;
+        return false;
+    }
+    uint32_t reserved = 0;
+    if (!readIndexHeader(in, path, "PCA", kPcaIndexMagic, kPcaIndexVersion, index.sourceDimension)) {
+        return false;
+    }
+    in.read(reinterpret_cast<char*>(&index.dimension), sizeof(index.dimension));
+    in.read(reinterpret_cast<char*>(&index.whitened), sizeof(index.whitened));
+    in.read(reinterpret_cast<char*>(&index.retainedVariance), sizeof(index.retainedVariance));
+    in.read(reinterpret_cast<char*>(&reserved), sizeof(reserved));
+    in.read(reinterpret_cast<char*>(&index.rowCount), sizeof(index.rowCount));
+    in.read(reinterpret_cast<char*>(&index.storeFingerprint), sizeof(index.storeFingerprint));
+    uint64_t left = bytesLeft(in);
+    uint64_t matrixRowBytes = (static_cast<uint64_t>(index.dimension) + 1) * sizeof(float);
+    if (!in || index.dimension == 0 || index.dimension > index.sourceDimension ||
+        index.sourceDimension > left / matrixRowBytes ||
+        index.rowCount > left / (index.dimension * sizeof(float))) {
+        std::cerr << "Error: PCA index " << path << " has an invalid header." << std::endl;
+        return false;
+    }
+    index.mean.resize(index.sourceDimension);
+    index.components.resize(static_cast<size_t>(index.dimension) * index.sourceDimension);
+    index.rows.resize(index.rowCount * index.dimension);
+    in.read(reinterpret_cast<char*>(index.mean.data()), index.mean.size() * sizeof(float));
+    in.read(reinterpret_cast<char*>(index.components.data()), index.components.size() * sizeof(float));
+    in.read(reinterpret_cast<char*>(index.rows.data()), index.rows.size() * sizeof(float));
+    if (!in) {
+        std::cerr << "Error: PCA index " << path << " is truncated." << std::endl;
+        return false;
+    }
+    pca_index_detail::computeHalfSquaredNorms(index);
+    return true;
+}
+
+#endif // PCA_INDEX_H
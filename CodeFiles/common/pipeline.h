@@ -0,0 +1,269 @@
+/*
+
+Authored by: Aadhi Aadhavan Balasubramanian, Harishraj Udaya Bhaskar
+Date: 10/17/2026
+
+*/
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <sys/stat.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Spin briefly, then yield, then sleep, so a starved stage does not burn a
+// core while it waits on the disk.
+class Backoff {
+public:
+    void wait() {
+        if (spins_ < 16) {
+#if defined(__x86_64__) || defined(__i386__)
+            _mm_pause();
+#endif
+        } else if (spins_ < 64) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        ++spins_;
+    }
+
+private:
+    int spins_ = 0;
+};
+
+// Bounded multi-producer/multi-consumer queue (Vyukov's ring buffer). Each
+// cell carries a sequence number that tells producers and consumers whether
+// it is free or filled, so push and pop are a single CAS on their cursor.
+// A full queue makes producers wait, which is the backpressure that keeps a
+// fast reader from racing ahead of the decoders.
+template <typename T>
+class BoundedQueue {
+public:
+    BoundedQueue(size_t capacity, int producers) : producers_(producers) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        mask_ = size - 1;
+        cells_.reset(new Cell[size]);
+        for (size_t i = 0; i < size; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool tryPush(T& value) {
+        Cell* cell;
+        size_t position = enqueuePosition_.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &cells_[position & mask_];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0) {
+                if (enqueuePosition_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = enqueuePosition_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& value) {
+        Cell* cell;
+        size_t position = dequeuePosition_.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &cells_[position & mask_];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+            if (difference == 0) {
+                if (dequeuePosition_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = dequeuePosition_.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->value);
+        cell->sequence.store(position + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Function to push, waiting while the queue is full
+    void push(T value) {
+        Backoff backoff;
+        while (!tryPush(value)) {
+            backoff.wait();
+        }
+    }
+
+    // Function to pop, waiting while the queue is empty; false once every producer is done and the queue is drained
+    bool pop(T& value) {
+        Backoff backoff;
+        while (!tryPop(value)) {
+            if (producers_.load(std::memory_order_acquire) == 0) {
+                return tryPop(value);
+            }
+            backoff.wait();
+        }
+        return true;
+    }
+
+    // Function called by each producer once it has pushed its last item
+    void producerDone() { producers_.fetch_sub(1, std::memory_order_acq_rel); }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_ = 0;
+    alignas(64) std::atomic<size_t> enqueuePosition_{ 0 };
+    alignas(64) std::atomic<size_t> dequeuePosition_{ 0 };
+    alignas(64) std::atomic<int> producers_;
+};
+
+// Thread counts for the three pipeline stages
+struct PipelineOptions {
+    int readers = 1;
+    int decoders = 1;
+    int extractors = 1;
+    size_t queueDepth = 64;
+};
+
+// Function to split a thread budget over the stages: a few readers to keep
+// the disk queue full, most threads on decoding, the rest on features.
+inline PipelineOptions pipelineOptionsFor(int threads) {
+    PipelineOptions options;
+    options.readers = std::max(1, threads / 8);
+    options.extractors = std::max(1, threads / 4);
+    options.decoders = std::max(1, threads - options.readers - options.extractors);
+    options.queueDepth = static_cast<size_t>(std::max(16, threads * 4));
+    return options;
+}
+
+// Function to check whether a path names a regular file (not a directory, socket or device)
+inline bool isRegularFile(const std::string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode);
+}
+
+// Function to read a whole file into memory, empty on failure. Anything but
+// a regular file (a subdirectory, a socket) counts as a failure; a directory
+// opens as a stream whose tellg() is meaningless.
+inline std::vector<unsigned char> readFileBytes(const std::string& path) {
+    if (!isRegularFile(path)) {
+        return {};
+    }
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in.is_open()) {
+        return {};
+    }
+    std::streamoff size = in.tellg();
+    if (size < 0) {
+        return {};
+    }
+    try {
+        std::vector<unsigned char> bytes(static_cast<size_t>(size));
+        in.seekg(0);
+        if (!in.read(reinterpret_cast<char*>(bytes.data()), bytes.size())) {
+            return {};
+        }
+        return bytes;
+    } catch (const std::exception&) {
+        return {};
+    }
+}
+
+// Function to run items [0, count) through three stages connected by
+// bounded queues: read(i) returns the raw bytes, decode(bytes) turns them
+// into an image, and extract(worker, i, image) consumes it. extract's worker
+// is in [0, options.extractors) so callers can keep per-worker results.
+// An exception from read or decode is reported and replaced by empty bytes or
+// an empty image, so extract sees the item fail like an unreadable file. One
+// from extract is reported and the item dropped. None of them reaches the
+// stage threads, where it would terminate the process.
+template <typename Read, typename Decode, typename Extract>
+void runPipeline(size_t count, const PipelineOptions& options, Read read, Decode decode, Extract extract) {
+    typedef decltype(read(size_t())) Bytes;
+    typedef decltype(decode(std::declval<Bytes&>())) Image;
+
+    BoundedQueue<std::pair<size_t, Bytes>> fileQueue(options.queueDepth, options.readers);
+    BoundedQueue<std::pair<size_t, Image>> imageQueue(options.queueDepth, options.decoders);
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> threads;
+
+    for (int reader = 0; reader < options.readers; ++reader) {
+        threads.emplace_back([&] {
+            for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+                Bytes bytes;
+                try {
+                    bytes = read(i);
+                } catch (const std::exception& error) {
+                    std::cerr << "Error: Reading item " << i << " failed: " << error.what() << std::endl;
+                }
+                fileQueue.push(std::make_pair(i, std::move(bytes)));
+            }
+            fileQueue.producerDone();
+        });
+    }
+    for (int decoder = 0; decoder < options.decoders; ++decoder) {
+        threads.emplace_back([&] {
+            std::pair<size_t, Bytes> file;
+            while (fileQueue.pop(file)) {
+                Image decoded;
+                try {
+                    decoded = decode(file.second);
+                } catch (const std::exception& error) {
+                    std::cerr << "Error: Decoding item " << file.first << " failed: " << error.what() << std::endl;
+                }
+                imageQueue.push(std::make_pair(file.first, std::move(decoded)));
+            }
+            imageQueue.producerDone();
+        });
+    }
+    for (int worker = 0; worker < options.extractors; ++worker) {
+        threads.emplace_back([&, worker] {
+            std::pair<size_t, Image> image;
+            while (imageQueue.pop(image)) {
+                try {
+                    extract(worker, image.first, image.second);
+                } catch (const std::exception& error) {
+                    std::cerr << "Error: Extracting features of item " << image.first << " failed: " << error.what() << std::endl;
+                }
+            }
+        });
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+#endif // PIPELINE_H
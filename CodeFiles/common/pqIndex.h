@@ -0,0 +1,318 @@
+/*
+
+Authored by: Aadhi Aadhavan Balasubramanian, Harishraj Udaya Bhaskar
+Date: 10/17/2026
+
+*/
+
+#ifndef PQ_INDEX_H
+#define PQ_INDEX_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "dotKernels.h"
+#include "approximateIndex.h"
+#include "parallelScan.h"
+#include "topN.h"
+
+// Product-quantized (PQ) codes for the rows of an embedding store. Each
+// unit-length row is cut into subquantizerCount consecutive sub-vectors, and
+// every sub-vector is replaced by the number of its closest of 256 trained
+// centroids, so a row shrinks to subquantizerCount bytes. A query computes
+// its dot product with every centroid once into a lookup table. The
+// similarity of a row is then the sum of one table entry per byte of its
+// code (asymmetric distance computation). The top candidates can be
+// re-ranked exactly against the store rows. Those stay on disk in the
+// mapping until then.
+//
+// File layout (native byte order):
+//   char[8]  magic "CBIRPQ01"
+//   uint32   format version
+//   uint32   dimension
+//   uint32   subquantizer count
+//   uint64   row count of the store
+//   uint64   fingerprint of the store (embeddingStoreFingerprint)
+//   float    centroids[256][dimension]    (sub-vector s of every centroid at its columns)
+//   uint8    codes[rowCount][subquantizerCount]
+struct PqIndex {
+    uint32_t dimension = 0;
+    uint32_t subquantizerCount = 0;
+    uint64_t rowCount = 0;
+    uint64_t storeFingerprint = 0;
+    std::vector<float> centroids;
+    std::vector<uint8_t> codes;
+
+    // First column of sub-vector s; the last sub-vectors take the leftover columns
+    size_t subBegin(size_t s) const { return s * dimension / subquantizerCount; }
+    size_t subWidth(size_t s) const { return subBegin(s + 1) - subBegin(s); }
+};
+
+static const char kPqIndexMagic[8] = { 'C', 'B', 'I', 'R', 'P', 'Q', '0', '1' };
+static const uint32_t kPqIndexVersion = 2;
+static const size_t kPqCentroids = 256;
+static_assert(kPqCentroids == 256, "every uint8 PQ code must name a centroid, so loaded codes need no range check");
+
+namespace pq_index_detail {
+
+// Rows encoded per matrix product
+const size_t kEncodeBlockRows = 256;
+
+// Function to copy columns [begin, begin + width) of count rows into a dense matrix
+inline void copyColumns(const float* rows, size_t count, size_t dimension, size_t begin, size_t width, float* out) {
+    for (size_t i = 0; i < count; ++i) {
+        std::memcpy(out + i * width, rows + i * dimension + begin, width * sizeof(float));
+    }
+}
+
+// Function to find the closest centroid of every sub-vector by squared
+// distance, which is |c|^2 - 2 x.c once the constant |x|^2 is dropped
+inline void closestCentroids(const float* subRows, size_t count, const float* centroids, const float* centroidNorms,
+                             size_t width, uint8_t* out, size_t outStride) {
+    std::vector<float> products(count * kPqCentroids);
+    matrixProductTransposed(subRows, count, centroids, kPqCentroids, width, products.data());
+    for (size_t i = 0; i < count; ++i) {
+        const float* product = products.data() + i * kPqCentroids;
+        size_t best = 0;
+        float bestDistance = std::numeric_limits<float>::max();
+        for (size_t c = 0; c < kPqCentroids; ++c) {
+            float distance = centroidNorms[c] - 2.0f * product[c];
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                best = c;
+            }
+        }
+        out[i * outStride] = static_cast<uint8_t>(best);
+    }
+}
+
+// Function to train the 256 centroids of one sub-vector with k-means on the sample
+inline void trainSubquantizer(const std::vector<float>& subSample, size_t sampleCount, size_t width,
+                              std::mt19937& random, int iterations, float* centroids) {
+    std::vector<size_t> order(sampleCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), random);
+    for (size_t c = 0; c < kPqCentroids; ++c) {
+        std::memcpy(centroids + c * width, subSample.data() + order[c % sampleCount] * width, width * sizeof(float));
+    }
+
+    std::vector<uint8_t> assignment(sampleCount);
+    std::vector<float> norms(kPqCentroids);
+    std::uniform_int_distribution<size_t> pick(0, sampleCount - 1);
+    for (int iteration = 0; iteration < iterations; ++iteration) {
+        for (size_t c = 0; c < kPqCentroids; ++c) {
+            norms[c] = dotProduct(centroids + c * width, centroids + c * width, width);
+        }
+        closestCentroids(subSample.data(), sampleCount, centroids, norms.data(), width, assignment.data(), 1);
+
+        std::vector<double> sums(kPqCentroids * width, 0.0);
+        std::vector<size_t> sizes(kPqCentroids, 0);
+        for (size_t i = 0; i < sampleCount; ++i) {
+            double* sum = sums.data() + assignment[i] * width;
+            const float* row = subSample.data() + i * width;
+            for (size_t k = 0; k < width; ++k) {
+                sum[k] += row[k];
+            }
+            ++sizes[assignment[i]];
+        }
+
+        // Empty centroids restart from a random sample sub-vector
+        for (size_t c = 0; c < kPqCentroids; ++c) {
+            float* centroid = centroids + c * width;
+            if (sizes[c] == 0) {
+                std::memcpy(centroid, subSample.data() + pick(random) * width, width * sizeof(float));
+                continue;
+            }
+            for (size_t k = 0; k < width; ++k) {
+                centroid[k] = static_cast<float>(sums[c * width + k] / sizes[c]);
+            }
+        }
+    }
+}
+
+} // namespace pq_index_detail
+
+// Function to build PQ codes for count rows with subquantizerCount bytes per
+// row. Each sub-vector is trained with k-means on a sample of at most 64 rows
+// per centroid, and the sub-vectors are trained in parallel.
+inline void buildPqIndex(const float* rows, size_t count, size_t dimension, size_t subquantizerCount, ThreadPool& pool,
+                         PqIndex& index, int iterations = 10) {
+    using namespace pq_index_detail;
+    subquantizerCount = std::max<size_t>(1, std::min(subquantizerCount, dimension));
+    index.dimension = static_cast<uint32_t>(dimension);
+    index.subquantizerCount = static_cast<uint32_t>(subquantizerCount);
+    index.rowCount = count;
+    index.centroids.assign(kPqCentroids * dimension, 0.0f);
+    index.codes.assign(count * subquantizerCount, 0);
+    if (count == 0) {
+        return;
+    }
+
+    // The sample is copied at unit length, as the codes describe the unit-length rows
+    std::mt19937 random(12345);
+    std::vector<size_t> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), random);
+    size_t sampleCount = std::min(count, kPqCentroids * 64);
+    std::vector<float> sample(sampleCount * dimension);
+    for (size_t i = 0; i < sampleCount; ++i) {
+        normalizeVector(rows + order[i] * dimension, sample.data() + i * dimension, dimension);
+    }
+
+    // Centroids of sub-vector s are trained as a dense 256 x width block, then scattered into their columns
+    parallelFor(pool, subquantizerCount, [&](size_t s) {
+        size_t begin = index.subBegin(s), width = index.subWidth(s);
+        std::vector<float> subSample(sampleCount * width), centroids(kPqCentroids * width);
+        copyColumns(sample.data(), sampleCount, dimension, begin, width, subSample.data());
+        std::mt19937 subRandom(static_cast<uint32_t>(12345 + s));
+        trainSubquantizer(subSample, sampleCount, width, subRandom, iterations, centroids.data());
+        for (size_t c = 0; c < kPqCentroids; ++c) {
+            std::memcpy(index.centroids.data() + c * dimension + begin, centroids.data() + c * width, width * sizeof(float));
+        }
+    }, 1);
+
+    // Encode blocks of unit-length rows, one sub-vector at a time
+    size_t blocks = (count + kEncodeBlockRows - 1) / kEncodeBlockRows;
+    parallelFor(pool, blocks, [&](size_t block) {
+        size_t first = block * kEncodeBlockRows;
+        size_t blockRows = std::min(kEncodeBlockRows, count - first);
+        std::vector<float> unitRows(blockRows * dimension), subRows, centroids, norms(kPqCentroids);
+        for (size_t i = 0; i < blockRows; ++i) {
+            normalizeVector(rows + (first + i) * dimension, unitRows.data() + i * dimension, dimension);
+        }
+        for (size_t s = 0; s < subquantizerCount; ++s) {
+            size_t begin = index.subBegin(s), width = index.subWidth(s);
+            subRows.resize(blockRows * width);
+            centroids.resize(kPqCentroids * width);
+            copyColumns(unitRows.data(), blockRows, dimension, begin, width, subRows.data());
+            copyColumns(index.centroids.data(), kPqCentroids, dimension, begin, width, centroids.data());
+            for (size_t c = 0; c < kPqCentroids; ++c) {
+                norms[c] = dotProduct(centroids.data() + c * width, centroids.data() + c * width, width);
+            }
+            closestCentroids(subRows.data(), blockRows, centroids.data(), norms.data(), width,
+                             index.codes.data() + first * subquantizerCount + s, subquantizerCount);
+        }
+    }, 1);
+}
+
+// Function to fill the lookup table of a query: entry [s][c] is the dot
+// product of the query's sub-vector s with that sub-vector of centroid c
+inline void buildPqLookupTable(const PqIndex& index, const float* unitQuery, std::vector<float>& table) {
+    table.resize(index.subquantizerCount * kPqCentroids);
+    for (size_t s = 0; s < index.subquantizerCount; ++s) {
+        size_t begin = index.subBegin(s), width = index.subWidth(s);
+        for (size_t c = 0; c < kPqCentroids; ++c) {
+            table[s * kPqCentroids + c] = dotProduct(unitQuery + begin, index.centroids.data() + c * index.dimension + begin, width);
+        }
+    }
+}
+
+// Function to rank the rows closest to a unit-length query by their codes,
+// closest first. When rerank is larger than zero, the best max(rerank, N) code
+// matches are scored again exactly against the store rows; rowsNormalized
+// tells whether those have unit length.
+inline std::vector<TopN<size_t>::Entry> searchPqIndex(const PqIndex& index, const float* rows, bool rowsNormalized,
+                                                      const float* unitQuery, int N, size_t rerank, ThreadPool& pool) {
+    std::vector<float> table;
+    buildPqLookupTable(index, unitQuery, table);
+    size_t codeBytes = index.subquantizerCount;
+    int candidates = rerank > 0 ? std::max(N, static_cast<int>(rerank)) : N;
+
+    // Rows are scanned in blocks of 4096 codes so each task streams a contiguous run
+    const size_t blockRows = 4096;
+    size_t blocks = (index.rowCount + blockRows - 1) / blockRows;
+    std::vector<TopN<size_t>> partials = parallelScan(pool, blocks, TopN<size_t>(candidates), [&](size_t block, TopN<size_t>& best) {
+        size_t first = block * blockRows;
+        size_t last = std::min<size_t>(first + blockRows, index.rowCount);
+        for (size_t i = first; i < last; ++i) {
+            // Four running sums keep the table loads independent of each other
+            const uint8_t* code = index.codes.data() + i * codeBytes;
+            const float* entries = table.data();
+            float sums[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            size_t s = 0;
+            for (; s + 4 <= codeBytes; s += 4, entries += 4 * kPqCentroids) {
+                sums[0] += entries[code[s]];
+                sums[1] += entries[kPqCentroids + code[s + 1]];
+                sums[2] += entries[2 * kPqCentroids + code[s + 2]];
+                sums[3] += entries[3 * kPqCentroids + code[s + 3]];
+            }
+            for (; s < codeBytes; ++s, entries += kPqCentroids) {
+                sums[0] += entries[code[s]];
+            }
+            best.push(1.0f - ((sums[0] + sums[1]) + (sums[2] + sums[3])), i);
+        }
+    }, 1);
+    std::vector<TopN<size_t>::Entry> matches = mergeTopN(partials).sorted();
+    if (rerank == 0) {
+        return matches;
+    }
+
+    return rerankExact(rows, rowsNormalized, unitQuery, index.dimension, matches, N);
+}
+
+// Function to check whether a file starts with the PQ index magic
+inline bool isPqIndexFile(const std::string& path) {
+    return hasIndexMagic(path, kPqIndexMagic);
+}
+
+// Function to write PQ codes to disk
+inline bool savePqIndex(const PqIndex& index, const std::string& path) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Error: Unable to open PQ index " << path << " for writing." << std::endl;
+        return false;
+    }
+    writeIndexHeader(out, kPqIndexMagic, kPqIndexVersion, index.dimension);
+    out.write(reinterpret_cast<const char*>(&index.subquantizerCount), sizeof(index.subquantizerCount));
+    out.write(reinterpret_cast<const char*>(&index.rowCount), sizeof(index.rowCount));
+    out.write(reinterpret_cast<const char*>(&index.storeFingerprint), sizeof(index.storeFingerprint));
+    out.write(reinterpret_cast<const char*>(index.centroids.data()), index.centroids.size() * sizeof(float));
+    out.write(reinterpret_cast<const char*>(index.codes.data()), index.codes.size());
+    out.close();
+    if (!out) {
+        std::cerr << "Error: Failed while writing PQ index " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Function to read PQ codes from disk
+inline bool loadPqIndex(const std::string& path, PqIndex& index) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "Error: Unable to open PQ index " << path << std::endl;
+        return false;
+    }
+    if (!readIndexHeader(in, path, "PQ", kPqIndexMagic, kPqIndexVersion, index.dimension)) {
+        return false;
+    }
+    in.read(reinterpret_cast<char*>(&index.subquantizerCount), sizeof(index.subquantizerCount));
+    in.read(reinterpret_cast<char*>(&index.rowCount), sizeof(index.rowCount));
+    in.read(reinterpret_cast<char*>(&index.storeFingerprint), sizeof(index.storeFingerprint));
+    uint64_t left = bytesLeft(in);
+    if (!in || index.subquantizerCount == 0 || index.subquantizerCount > index.dimension ||
+        index.dimension > left / (kPqCentroids * sizeof(float)) || index.rowCount > left / index.subquantizerCount) {
+        std::cerr << "Error: PQ index " << path << " has an invalid header." << std::endl;
+        return false;
+    }
+    index.centroids.resize(kPqCentroids * index.dimension);
+    index.codes.resize(index.rowCount * index.subquantizerCount);
+    in.read(reinterpret_cast<char*>(index.centroids.data()), index.centroids.size() * sizeof(float));
+    in.read(reinterpret_cast<char*>(index.codes.data()), index.codes.size());
+    if (!in) {
+        std::cerr << "Error: PQ index " << path << " is truncated." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+#endif // PQ_INDEX_H
@@ -0,0 +1,92 @@
+/*
+
+Authored by: Aadhi Aadhavan Balasubramanian, Harishraj Udaya Bhaskar
+Date: 10/17/2026
+
+*/
+
+#ifndef RESULT_WRITER_H
+#define RESULT_WRITER_H
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// With --headless the query binaries skip every window and the re-decode of
+// the matches, and print one JSON object per match instead:
+//   {"query":"...","rank":1,"path":"...","distance":0.12,"components":{"top":0.1,"bottom":0.14},"timings_ms":{"target":3.1,"scan":41.7,"total":45.0}}
+// components holds the per-feature distances a combined distance is built
+// from (empty for single-feature binaries); timings_ms is the same for every
+// match of a query.
+
+// (name, value) pairs, written in order
+typedef std::vector<std::pair<std::string, double>> NamedValues;
+
+// Wall-clock timer for the timings_ms field
+class Stopwatch {
+public:
+    Stopwatch() : start_(std::chrono::steady_clock::now()) {}
+
+    double millis() const {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Function to quote a string as a JSON string literal
+inline std::string jsonString(const std::string& value) {
+    std::string quoted = "\"";
+    for (char c : value) {
+        switch (c) {
+            case '"': quoted += "\\\""; break;
+            case '\\': quoted += "\\\\"; break;
+            case '\n': quoted += "\\n"; break;
+            case '\r': quoted += "\\r"; break;
+            case '\t': quoted += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    quoted += escaped;
+                } else {
+                    quoted += c;
+                }
+        }
+    }
+    return quoted + "\"";
+}
+
+// Function to format a number for JSON, which has no NaN or infinity
+inline std::string jsonNumber(double value) {
+    if (!std::isfinite(value)) {
+        return "null";
+    }
+    char formatted[32];
+    std::snprintf(formatted, sizeof(formatted), "%.9g", value);
+    return formatted;
+}
+
+// Function to format named values as a JSON object
+inline std::string jsonObject(const NamedValues& values) {
+    std::string object = "{";
+    for (size_t i = 0; i < values.size(); ++i) {
+        object += (i > 0 ? "," : "") + jsonString(values[i].first) + ":" + jsonNumber(values[i].second);
+    }
+    return object + "}";
+}
+
+// Function to write one match of a query as a JSON Lines record; rank starts at 1
+inline void writeResultRecord(std::ostream& out, const std::string& query, size_t rank, const std::string& path,
+                              double distance, const NamedValues& components, const NamedValues& timings) {
+    out << "{\"query\":" << jsonString(query) << ",\"rank\":" << rank << ",\"path\":" << jsonString(path)
+        << ",\"distance\":" << jsonNumber(distance) << ",\"components\":" << jsonObject(components)
+        << ",\"timings_ms\":" << jsonObject(timings) << "}\n";
+}
+
+#endif // RESULT_WRITER_H
@@ -0,0 +1,157 @@
+/*
+
+Authored by: Aadhi Aadhavan Balasubramanian, Harishraj Udaya Bhaskar
+Date: 10/17/2026
+
+*/
+
+#ifndef TEXTURE_HISTOGRAM_H
+#define TEXTURE_HISTOGRAM_H
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+namespace texture_histogram_detail {
+
+// cvtColor(COLOR_BGR2GRAY) fixed-point weights for 8-bit images (14-bit shift)
+const int kGrayShift = 14;
+const int kBlueWeight = 1868;
+const int kGreenWeight = 9617;
+const int kRedWeight = 4899;
+
+// Polynomial atan2 in degrees that cartToPolar/fastAtan2 use, so orientations
+// land in the same bins as the cartToPolar + calcHist path did
+inline float fastAtan2Degrees(float y, float x) {
+    const float scale = static_cast<float>(180.0 / CV_PI);
+    const float p1 = 0.9997878412794807f * scale;
+    const float p3 = -0.3258083974640975f * scale;
+    const float p5 = 0.1555786518463281f * scale;
+    const float p7 = -0.04432655554792128f * scale;
+    float ax = std::abs(x), ay = std::abs(y);
+    float c = ax >= ay ? ay / (ax + static_cast<float>(DBL_EPSILON)) : ax / (ay + static_cast<float>(DBL_EPSILON));
+    float c2 = c * c;
+    float a = (((p7 * c2 + p5) * c2 + p3) * c2 + p1) * c;
+    if (ax < ay) {
+        a = 90.f - a;
+    }
+    if (x < 0) {
+        a = 180.f - a;
+    }
+    if (y < 0) {
+        a = 360.f - a;
+    }
+    return a;
+}
+
+// Function to index a row or column with BORDER_REFLECT_101, Sobel's default
+inline int reflect101(int i, int size) {
+    if (size == 1) {
+        return 0;
+    }
+    if (i < 0) {
+        return -i;
+    }
+    return i >= size ? 2 * size - 2 - i : i;
+}
+
+// Function to convert one BGR row to gray, with one reflected pixel of padding on each side
+inline void grayRow(const uchar* bgr, int cols, int32_t* padded) {
+    for (int x = 0; x < cols; ++x, bgr += 3) {
+        padded[x + 1] = (bgr[0] * kBlueWeight + bgr[1] * kGreenWeight + bgr[2] * kRedWeight + (1 << (kGrayShift - 1))) >> kGrayShift;
+    }
+    padded[0] = padded[reflect101(-1, cols) + 1];
+    padded[cols + 1] = padded[reflect101(cols, cols) + 1];
+}
+
+// Function to scale a histogram to [0, 1] the way normalize(NORM_MINMAX) does
+inline void normalizeMinMax(std::vector<double>& bins, float* out) {
+    std::vector<float> values(bins.begin(), bins.end());
+    std::pair<std::vector<float>::iterator, std::vector<float>::iterator> range =
+        std::minmax_element(values.begin(), values.end());
+    double smin = *range.first, smax = *range.second;
+    double scale = smax - smin > DBL_EPSILON ? 1.0 / (smax - smin) : 0.0;
+    float a = static_cast<float>(scale);
+    float b = static_cast<float>(-smin * scale);
+    for (size_t i = 0; i < values.size(); ++i) {
+        out[i] = values[i] * a + b;
+    }
+}
+
+} // namespace texture_histogram_detail
+
+// Function to compute the histogram of 3x3 Sobel gradient orientations over
+// [0, 360) degrees of an 8-bit BGR image, normalized to [0, 1]. Equivalent to
+// BGR2GRAY, two CV_32F Sobel passes, cartToPolar and calcHist, but streamed:
+// only three gray rows and one row of gradients are kept, so the working set
+// stays in cache instead of five full-frame images. With magnitudeWeighted
+// each pixel adds its gradient magnitude instead of 1. Returns an empty Mat
+// for an image that is not CV_8UC3.
+inline cv::Mat computeOrientationHistogram(const cv::Mat& image, int numBins, bool magnitudeWeighted = false) {
+    using namespace texture_histogram_detail;
+    if (image.empty() || image.type() != CV_8UC3 || numBins <= 0) {
+        return cv::Mat();
+    }
+
+    const int rows = image.rows, cols = image.cols;
+    const size_t padded = static_cast<size_t>(cols) + 2;
+    std::vector<int32_t> ring(3 * padded);
+    std::vector<float> gx(cols), gy(cols), angle(cols);
+    std::vector<double> bins(numBins, 0.0);
+    std::vector<uint32_t> counts(numBins, 0);
+    const double binsPerDegree = numBins / 360.0;
+
+    // Gray row r lives in ring slot r % 3; rows -1 and `rows` are reflected
+    auto slot = [&](int r) { return ring.data() + (static_cast<size_t>(r) % 3) * padded; };
+    grayRow(image.ptr<uchar>(0), cols, slot(0));
+    if (rows > 1) {
+        grayRow(image.ptr<uchar>(1), cols, slot(1));
+    }
+
+    for (int y = 0; y < rows; ++y) {
+        if (y >= 1 && y + 1 < rows) {
+            grayRow(image.ptr<uchar>(y + 1), cols, slot(y + 1));
+        }
+        const int32_t* above = slot(reflect101(y - 1, rows));
+        const int32_t* middle = slot(y);
+        const int32_t* below = slot(reflect101(y + 1, rows));
+
+        // Sobel 3x3: gx smooths vertically then differences horizontally, gy the reverse
+        for (int x = 0; x < cols; ++x) {
+            int left = above[x] + 2 * middle[x] + below[x];
+            int right = above[x + 2] + 2 * middle[x + 2] + below[x + 2];
+            int top = above[x] + 2 * above[x + 1] + above[x + 2];
+            int bottom = below[x] + 2 * below[x + 1] + below[x + 2];
+            gx[x] = static_cast<float>(right - left);
+            gy[x] = static_cast<float>(bottom - top);
+        }
+        for (int x = 0; x < cols; ++x) {
+            angle[x] = fastAtan2Degrees(gy[x], gx[x]);
+        }
+
+        // Same binning as calcHist over [0, 360): values outside the range are dropped
+        for (int x = 0; x < cols; ++x) {
+            int bin = static_cast<int>(std::floor(angle[x] * binsPerDegree));
+            if (static_cast<unsigned>(bin) >= static_cast<unsigned>(numBins)) {
+                continue;
+            }
+            if (magnitudeWeighted) {
+                bins[bin] += std::sqrt(gx[x] * gx[x] + gy[x] * gy[x]);
+            } else {
+                ++counts[bin];
+            }
+        }
+    }
+
+    if (!magnitudeWeighted) {
+        std::copy(counts.begin(), counts.end(), bins.begin());
+    }
+    cv::Mat hist(numBins, 1, CV_32F);
+    normalizeMinMax(bins, hist.ptr<float>());
+    return hist;
+}
+
+#endif // TEXTURE_HISTOGRAM_H
@@ -0,0 +1,98 @@
+/*
+
+Authored by: Aadhi Aadhavan Balasubramanian, Harishraj Udaya Bhaskar
+Date: 10/17/2026
+
+*/
+
+#ifndef TOP_N_H
+#define TOP_N_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Keeps the N smallest distances seen so far in a bounded max-heap, so a
+// scan holds O(N) results and pays O(log N) only for candidates that beat
+// the current worst. Id is whatever identifies a match: a row number for
+// index and store scans, or a filename when rows are not kept around.
+template <typename Id>
+class TopN {
+public:
+    struct Entry {
+        double distance;
+        Id id;
+
+        // Ties are broken on the id so results do not depend on thread timing
+        bool operator<(const Entry& other) const {
+            return distance < other.distance || (distance == other.distance && id < other.id);
+        }
+    };
+
+    explicit TopN(int capacity = 0) : capacity_(capacity > 0 ? static_cast<size_t>(capacity) : 0) {
+        heap_.reserve(capacity_);
+    }
+
+    size_t size() const { return heap_.size(); }
+
+    // Function to check whether a distance would make it into the current top N
+    bool accepts(double distance) const {
+        return heap_.size() < capacity_ || (capacity_ > 0 && distance < heap_.front().distance);
+    }
+
+    void push(double distance, Id id) {
+        Entry entry{ distance, std::move(id) };
+        if (heap_.size() < capacity_) {
+            heap_.push_back(std::move(entry));
+            std::push_heap(heap_.begin(), heap_.end());
+        } else if (capacity_ > 0 && entry < heap_.front()) {
+            std::pop_heap(heap_.begin(), heap_.end());
+            heap_.back() = std::move(entry);
+            std::push_heap(heap_.begin(), heap_.end());
+        }
+    }
+
+    // Function to fold another collector's matches into this one
+    void merge(const TopN& other) {
+        for (const Entry& entry : other.heap_) {
+            push(entry.distance, entry.id);
+        }
+    }
+
+    // Function to return the kept matches from closest to farthest
+    std::vector<Entry> sorted() const {
+        std::vector<Entry> entries = heap_;
+        std::sort_heap(entries.begin(), entries.end());
+        return entries;
+    }
+
+private:
+    size_t capacity_;
+    std::vector<Entry> heap_;
+};
+
+// Id for a match whose distance combines several features: the row plus the
+// distance of each feature, which the headless output reports. Keeping them
+// in the id means a scan holds them only for its N kept matches. Ordered by
+// row alone, for TopN's tie-break.
+template <size_t Components>
+struct ScoredRow {
+    size_t row = 0;
+    std::array<double, Components> components{};
+
+    bool operator<(const ScoredRow& other) const { return row < other.row; }
+};
+
+// Function to merge the per-thread collectors of a parallel scan
+template <typename Id>
+TopN<Id> mergeTopN(const std::vector<TopN<Id>>& partials) {
+    TopN<Id> merged = partials.empty() ? TopN<Id>() : partials.front();
+    for (size_t i = 1; i < partials.size(); ++i) {
+        merged.merge(partials[i]);
+    }
+    return merged;
+}
+
+#endif // TOP_N_H
@@ -13,6 +13,10 @@ Date: 01/26/2024
 #include <thread>
 #include <boost/filesystem.hpp>
 #include <opencv2/opencv.hpp>
+#include "chiSquared.h"
+#include "colorHistograms.h"
+#include "cliOptions.h"
+#include "parallelScan.h"
 
 using namespace std;
 using namespace cv;
@@ -20,17 +24,7 @@ namespace fs = boost::filesystem;
 
 // Function to compute chi-squared distance between two histograms
 double computeChiSquaredDistance(const Mat& hist1, const Mat& hist2) {
-    double distance = 0.0;
-    for (int i = 0; i < hist1.rows; ++i) {
-        for (int j = 0; j < hist1.cols; ++j) {
-            double a = hist1.at<float>(i, j);
-            double b = hist2.at<float>(i, j);
-            if (a + b != 0) {
-                distance += pow(a - b, 2) / (a + b);
-            }
-        }
-    }
-    return distance;
+    return chiSquaredDistance(hist1, hist2);
 }
 
 // Function to compute multi-histogram distance
@@ -38,30 +32,20 @@ double computeMultiHistogramDistance(const Mat& hist1, const Mat& hist2) {
     return computeChiSquaredDistance(hist1, hist2);
 }
 
-// Function to compute RGB histogram for a given image
+// Function to compute RG chromaticity histogram for a given image
 Mat computeRGChromaticityHistogram(const Mat& image, int numBins) {
-    Mat hist;
-
-    // Convert image to float
-    Mat floatImage;
-    image.convertTo(floatImage, CV_32F);
-
-    // Compute RG chromaticity histogram
-    Mat rgHist;
-    int histSize[] = { numBins, numBins };
-    float rRanges[] = { 0, 256 };
-    float gRanges[] = { 0, 256 };
-    const float* ranges[] = { rRanges, gRanges };
-    int channels[] = { 0, 1 };
-    calcHist(&floatImage, 1, channels, Mat(), rgHist, 2, histSize, ranges, true, false);
-
-    // Normalize histogram
-    normalize(rgHist, hist, 0, 1, NORM_MINMAX, -1, Mat());
-
-    return hist;
+    // One pass over the 8-bit pixels, no float copy of the image
+    ColorHistogramSpec spec;
+    spec.rgBins = numBins;
+    return computeColorHistograms(image, spec).rg;
 }
 
-int main() {
+int main(int argc, char** argv) {
+    int threads = 0;
+    if (!takeThreadCount(argc, argv, threads)) {
+        return 1;
+    }
+
     // Open the camera
     VideoCapture cap(0);
     if (!cap.isOpened()) {
@@ -71,16 +55,29 @@ int main() {
 
     // Read images from the directory and compute their histograms
     string imageDirPath = "/Users/aadhi/Desktop/CS5330/Project2/olympus"; // Update this with your image directory path
-    vector<pair<Mat, string>> images;
+    vector<string> imagePaths;
     for (const auto& entry : fs::directory_iterator(imageDirPath)) {
-        string imagePath = entry.path().string();
-        Mat image = imread(imagePath);
-        if (image.empty()) {
-            cerr << "Error: Unable to read image " << imagePath << endl;
-            continue;
+        imagePaths.push_back(entry.path().string());
+    }
+    vector<Mat> hists(imagePaths.size());
+    {
+        // Images are spread over the pool, so keep OpenCV's own threads out of the way
+        setNumThreads(1);
+        ThreadPool pool(threads);
+        parallelFor(pool, imagePaths.size(), [&](size_t i) {
+            Mat image = imread(imagePaths[i]);
+            if (image.empty()) {
+                cerr << "Error: Unable to read image " << imagePaths[i] << endl;
+                return;
+            }
+            hists[i] = computeRGChromaticityHistogram(image, 16);
+        });
+    }
+    vector<pair<Mat, string>> images;
+    for (size_t i = 0; i < imagePaths.size(); ++i) {
+        if (!hists[i].empty()) {
+            images.emplace_back(hists[i], imagePaths[i]);
         }
-        Mat hist = computeRGChromaticityHistogram(image, 16);
-        images.emplace_back(hist, imagePath);
     }
 
     // Main loop
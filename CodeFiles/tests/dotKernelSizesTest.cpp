@@ -0,0 +1,100 @@
+/*
+
+Authored by: Aadhi Aadhavan Balasubramanian, Harishraj Udaya Bhaskar
+Date: 10/17/2026
+
+*/
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "dotKernels.h"
+
+using namespace std;
+using namespace dot_kernels_detail;
+
+int failures = 0;
+
+// Function to record a failed check
+void check(bool condition, const string& message) {
+    if (!condition) {
+        cerr << "FAIL: " << message << endl;
+        ++failures;
+    }
+}
+
+// Function to compare one dot and matrix-vector kernel pair with a double
+// reference. Seven rows leave a tail of three after the four-row blocks.
+void checkKernels(const string& name, const DotKernels& kernels, size_t dimension, mt19937& random) {
+    const size_t rows = 7;
+    normal_distribution<float> gaussian(0.0f, 1.0f);
+    vector<float> matrix(rows * dimension), vector(dimension), out(rows);
+    for (float& value : matrix) {
+        value = gaussian(random);
+    }
+    for (float& value : vector) {
+        value = gaussian(random);
+    }
+    kernels.gemv(matrix.data(), rows, dimension, vector.data(), out.data());
+    for (size_t r = 0; r < rows; ++r) {
+        const float* row = matrix.data() + r * dimension;
+        double expected = 0.0, magnitude = 0.0;
+        for (size_t k = 0; k < dimension; ++k) {
+            expected += static_cast<double>(row[k]) * vector[k];
+            magnitude += fabs(static_cast<double>(row[k]) * vector[k]);
+        }
+        double tolerance = 1e-5 * magnitude + 1e-6;
+        string where = name + " at dimension " + to_string(dimension) + ", row " + to_string(r);
+        check(fabs(kernels.dot(row, vector.data(), dimension) - expected) < tolerance, where + ": dot is wrong");
+        check(fabs(out[r] - expected) < tolerance, where + ": gemv is wrong");
+    }
+}
+
+// Function to check the kernels of one specialized dimension on every path
+// the CPU supports, along with the generic kernels at Dim and at a size with
+// a tail that is not a whole vector register
+template <size_t Dim>
+void checkDimension(mt19937& random) {
+    const size_t tailDimension = Dim + 5;
+    checkKernels("scalar", { scalarDot, scalarGemv }, Dim, random);
+    checkKernels("scalar", { scalarDot, scalarGemv }, tailDimension, random);
+#ifdef CBIR_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        checkKernels("avx2 fixed", { avx2DotFixed<Dim>, avx2GemvFixed<Dim> }, Dim, random);
+        checkKernels("avx2", { avx2Dot, avx2Gemv }, Dim, random);
+        checkKernels("avx2", { avx2Dot, avx2Gemv }, tailDimension, random);
+    }
+    if (__builtin_cpu_supports("avx512f")) {
+        checkKernels("avx512 fixed", { avx512DotFixed<Dim>, avx512GemvFixed<Dim> }, Dim, random);
+        checkKernels("avx512", { avx512Dot, avx512Gemv }, Dim, random);
+        checkKernels("avx512", { avx512Dot, avx512Gemv }, tailDimension, random);
+    }
+#endif
+
+    // The lookup hands out the specialized pair for Dim and the generic one otherwise
+    DotKernels fixed = selectFixedDotKernels<Dim>();
+    const DotKernels& selected = dotKernelsFor(Dim);
+    check(selected.dot == fixed.dot && selected.gemv == fixed.gemv, "dotKernelsFor(" + to_string(Dim) + ") is not the fixed pair");
+    const DotKernels& generic = dotKernelsFor(tailDimension);
+    check(generic.dot == selectDotKernel() && generic.gemv == selectGemvKernel(),
+          "dotKernelsFor(" + to_string(tailDimension) + ") is not the generic pair");
+    checkKernels("selected", selected, Dim, random);
+    checkKernels("selected", generic, tailDimension, random);
+}
+
+int main() {
+    mt19937 random(5);
+    checkDimension<128>(random);
+    checkDimension<256>(random);
+    checkDimension<512>(random);
+    checkDimension<768>(random);
+    checkDimension<2048>(random);
+
+    if (failures == 0) {
+        cout << "dotKernelSizesTest passed" << endl;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+/*
+
+Authored by: Aadhi Aadhavan Balasubramanian, Harishraj Udaya Bhaskar
+Date: 10/17/2026
+
+*/
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "dotKernels.h"
+#include "int8Index.h"
+
+using namespace std;
+
+int failures = 0;
+
+// Function to record a failed check
+void check(bool condition, const string& message) {
+    if (!condition) {
+        cerr << "FAIL: " << message << endl;
+        ++failures;
+    }
+}
+
+int main() {
+    const size_t dimension = 37, count = 9, zeroRow = 4;
+    mt19937 random(7);
+    normal_distribution<float> gaussian(0.0f, 1.0f);
+    vector<float> rows(count * dimension);
+    for (float& value : rows) {
+        value = gaussian(random);
+    }
+    fill(rows.begin() + zeroRow * dimension, rows.begin() + (zeroRow + 1) * dimension, 0.0f);
+    vector<float> query(dimension);
+    for (float& value : query) {
+        value = gaussian(random);
+    }
+    normalizeVector(query.data(), query.data(), dimension);
+
+    // Rows that are not unit length: the zero row is at distance 1, the rest match a plain cosine
+    vector<float> distances(count);
+    cosineDistances(rows.data(), count, dimension, query.data(), false, distances.data());
+    for (size_t r = 0; r < count; ++r) {
+        const float* row = rows.data() + r * dimension;
+        double expected = 1.0;
+        if (r != zeroRow) {
+            double dot = 0.0, length = 0.0;
+            for (size_t k = 0; k < dimension; ++k) {
+                dot += row[k] * query[k];
+                length += row[k] * row[k];
+            }
+            expected = 1.0 - dot / sqrt(length);
+        }
+        check(isfinite(distances[r]), "cosineDistances row " + to_string(r) + " is not finite");
+        check(fabs(distances[r] - expected) < 1e-5, "cosineDistances row " + to_string(r) + " is wrong");
+        check(fabs(rowCosineDistance(row, query.data(), dimension, false) - expected) < 1e-5,
+              "rowCosineDistance row " + to_string(r) + " is wrong");
+    }
+
+    // The exact re-rank of an approximate search sees the zero row too
+    ThreadPool pool(2);
+    Int8Index index;
+    buildInt8Index(rows.data(), count, dimension, pool, index);
+    vector<TopN<size_t>::Entry> matches = searchInt8Index(index, rows.data(), false, query.data(), static_cast<int>(count), count, pool);
+    check(matches.size() == count, "int8 re-rank dropped rows");
+    for (const TopN<size_t>::Entry& match : matches) {
+        check(isfinite(match.distance), "int8 re-rank distance of row " + to_string(match.id) + " is not finite");
+        check(match.id != zeroRow || fabs(match.distance - 1.0) < 1e-6, "int8 re-rank distance of the zero row is not 1");
+    }
+
+    if (failures == 0) {
+        cout << "dotKernelsTest passed" << endl;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,90 @@
+/*
+
+Authored by: Aadhi Aadhavan Balasubramanian, Harishraj Udaya Bhaskar
+Date: 10/17/2026
+
+*/
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "patchMatrix.h"
+
+using namespace std;
+
+int failures = 0;
+
+// Function to record a failed check
+void check(bool condition, const string& message) {
+    if (!condition) {
+        cerr << "FAIL: " << message << endl;
+        ++failures;
+    }
+}
+
+// Function to score every block length from 1 to 9 rows, at every start, so
+// the four-row kernel sees each tail, and compare it with the scalar path
+void checkBlocks(const PatchMatrix& patches, const uint8_t* query, const string& name) {
+    vector<uint8_t> padded = padPatchQuery(patches, query);
+    vector<uint32_t> expected(patches.rows()), distances(patches.rows());
+    patch_matrix_detail::scalarSsdRows(patches.row(0), patches.rows(), patches.stride(), padded.data(), patches.dimension(), expected.data());
+    for (size_t count = 1; count <= 9; ++count) {
+        for (size_t first = 0; first + count <= patches.rows(); ++first) {
+            patchSquaredDistances(patches, first, count, padded.data(), distances.data());
+            for (size_t r = 0; r < count; ++r) {
+                check(distances[r] == expected[first + r], name + ": row " + to_string(first + r) + " of a block of " + to_string(count) + " is wrong");
+            }
+        }
+    }
+    for (size_t r = 0; r < patches.rows(); ++r) {
+        check(patchSquaredDistance(patches.row(r), query, patches.dimension()) == expected[r],
+              name + ": patchSquaredDistance of row " + to_string(r) + " is wrong");
+    }
+}
+
+int main() {
+    const size_t dimension = 7 * 7 * 3, count = 11;
+    mt19937 random(3);
+    uniform_int_distribution<int> byteValue(0, 255);
+
+    // Rows 0 and 1 sit at the 255 and 0 extremes, the rest are random; the
+    // matrix is filled from packed bytes the way an index query fills it
+    vector<uint8_t> packed(count * dimension);
+    for (size_t i = 0; i < packed.size(); ++i) {
+        packed[i] = i < dimension ? 255 : i < 2 * dimension ? 0 : static_cast<uint8_t>(byteValue(random));
+    }
+    PatchMatrix patches;
+    patches.reset(count, dimension);
+    copyPatchRows(packed.data(), 0, count, patches);
+    for (size_t r = 0; r < count; ++r) {
+        check(equal(packed.begin() + r * dimension, packed.begin() + (r + 1) * dimension, patches.row(r)),
+              "copyPatchRows row " + to_string(r) + " is wrong");
+    }
+
+    // The largest distance, every byte 255 apart, must not wrap
+    vector<uint8_t> zeros(dimension, 0), randomQuery(dimension);
+    for (uint8_t& value : randomQuery) {
+        value = static_cast<uint8_t>(byteValue(random));
+    }
+    check(patchSquaredDistance(patches.row(0), zeros.data(), dimension) == dimension * 255 * 255, "255 against 0 is wrong");
+    checkBlocks(patches, zeros.data(), "zero query");
+    checkBlocks(patches, patches.row(0), "255 query");
+    checkBlocks(patches, randomQuery.data(), "random query");
+
+    // Float rows of older indexes round to the same bytes
+    vector<float> floats(packed.begin(), packed.end());
+    PatchMatrix rounded;
+    rounded.reset(count, dimension);
+    fillPatchRows(floats.data(), 0, count, rounded);
+    for (size_t r = 0; r < count; ++r) {
+        check(equal(packed.begin() + r * dimension, packed.begin() + (r + 1) * dimension, rounded.row(r)),
+              "fillPatchRows row " + to_string(r) + " is wrong");
+    }
+
+    if (failures == 0) {
+        cout << "patchMatrixTest passed" << endl;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,66 @@
+/*
+
+Authored by: Aadhi Aadhavan Balasubramanian, Harishraj Udaya Bhaskar
+Date: 10/17/2026
+
+*/
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "dotKernels.h"
+#include "pcaIndex.h"
+
+using namespace std;
+
+int failures = 0;
+
+// Function to record a failed check
+void check(bool condition, const string& message) {
+    if (!condition) {
+        cerr << "FAIL: " << message << endl;
+        ++failures;
+    }
+}
+
+int main() {
+    const size_t dimension = 24, count = 400;
+    const int N = 20;
+    mt19937 random(11);
+    uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    // Non-negative unit-length rows, like normalized ResNet features
+    vector<float> rows(count * dimension);
+    for (float& value : rows) {
+        value = uniform(random);
+    }
+    for (size_t r = 0; r < count; ++r) {
+        normalizeVector(rows.data() + r * dimension, rows.data() + r * dimension, dimension);
+    }
+
+    // Keeping every axis, the projected ranking must be the exact cosine ranking
+    ThreadPool pool(2);
+    PcaIndex index;
+    buildPcaIndex(rows.data(), count, dimension, dimension, false, pool, index);
+    for (size_t target = 0; target < count; target += 37) {
+        const float* query = rows.data() + target * dimension;
+        TopN<size_t> exact(N);
+        for (size_t r = 0; r < count; ++r) {
+            exact.push(rowCosineDistance(rows.data() + r * dimension, query, dimension, true), r);
+        }
+        vector<TopN<size_t>::Entry> expected = exact.sorted();
+        vector<TopN<size_t>::Entry> matches = searchPcaIndex(index, rows.data(), true, query, N, 0, pool);
+        check(matches.size() == expected.size(), "PCA search of row " + to_string(target) + " returned the wrong count");
+        for (size_t i = 0; i < matches.size() && i < expected.size(); ++i) {
+            string where = "PCA rank " + to_string(i) + " of row " + to_string(target);
+            check(matches[i].id == expected[i].id, where + " is not the exact match");
+            check(fabs(matches[i].distance - expected[i].distance) < 1e-4, where + " has the wrong distance");
+        }
+    }
+
+    if (failures == 0) {
+        cout << "pcaIndexTest passed" << endl;
+    }
+    return failures == 0 ? 0 : 1;
+}